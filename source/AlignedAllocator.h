@@ -0,0 +1,45 @@
+#pragma once
+
+//Standard includes
+#include <cstddef>
+#include <new>
+
+namespace dae
+{
+	//Size of a cache line on the x86 CPUs this targets. Buffers that several threads write to are aligned to it,
+	//so two threads only ever share a line where their regions meet, not because of where the allocation started
+	constexpr size_t g_CacheLineSize{ 64 };
+
+	//Allocator for std::vector that aligns the storage to Alignment bytes
+	template<typename T, size_t Alignment = g_CacheLineSize>
+	class AlignedAllocator
+	{
+	public:
+		using value_type = T;
+
+		template<typename U>
+		struct rebind
+		{
+			using other = AlignedAllocator<U, Alignment>;
+		};
+
+		AlignedAllocator() noexcept = default;
+		template<typename U>
+		AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+		T* allocate(size_t count)
+		{
+			return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t{ Alignment }));
+		}
+
+		void deallocate(T* pData, size_t)
+		{
+			::operator delete(pData, std::align_val_t{ Alignment });
+		}
+
+		template<typename U>
+		bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept { return true; }
+		template<typename U>
+		bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept { return false; }
+	};
+}
@@ -3,6 +3,8 @@
 
 #include "Math.h"
 #include "vector"
+#include <memory>
+#include <span>
 
 namespace dae
 {
@@ -54,6 +56,33 @@ namespace dae
 		unsigned char materialIndex{};
 	};
 
+	//Untransformed source geometry, immutable once built so meshes and threads can share it.
+	//The spans point either into the owned vectors or into memory kept alive by pStorage (e.g. a mapped mesh cache)
+	struct MeshGeometry
+	{
+		MeshGeometry() = default;
+		~MeshGeometry() = default;
+
+		MeshGeometry(const MeshGeometry&) = delete;
+		MeshGeometry(MeshGeometry&&) noexcept = delete;
+		MeshGeometry& operator=(const MeshGeometry&) = delete;
+		MeshGeometry& operator=(MeshGeometry&&) noexcept = delete;
+
+		std::span<const Vector3> positions{};
+		std::span<const Vector3> normals{};
+		std::span<const int> indices{};
+
+		Vector3 minAABB{};
+		Vector3 maxAABB{};
+		//Hash of the arrays above, identical assets stored under different paths share one geometry
+		uint64_t contentHash{};
+
+		std::vector<Vector3> ownedPositions{};
+		std::vector<Vector3> ownedNormals{};
+		std::vector<int> ownedIndices{};
+		std::shared_ptr<const void> pStorage{};
+	};
+
 	struct TriangleMesh
 	{
 		TriangleMesh() = default;
@@ -83,6 +112,8 @@ namespace dae
 		std::vector<Vector3> positions{};
 		std::vector<Vector3> normals{};
 		std::vector<int> indices{};
+		//Shared source geometry, when set it's used instead of positions/normals/indices
+		std::shared_ptr<const MeshGeometry> pGeometry{};
 		unsigned char materialIndex{};
 
 		TriangleCullMode cullMode{TriangleCullMode::BackFaceCulling};
@@ -97,8 +128,12 @@ namespace dae
 		Vector3 transformedMinAABB;
 		Vector3 transformedMaxAABB;
 
-		std::vector<Vector3> transformedPositions{};
-		std::vector<Vector3> transformedNormals{};
+		//Rays are traced in object space, so instances of the same geometry don't need their own transformed copy of it
+		Matrix worldTransform{};
+		Matrix inverseWorldTransform{};
+
+		//Incremented every time the transformed data changes
+		uint32_t transformVersion{};
 
 		void Translate(const Vector3& translation)
 		{
@@ -120,6 +155,20 @@ namespace dae
 			scaleTransform = Matrix::CreateScale(scale);
 		}
 
+		std::span<const Vector3> GetPositions() const { return pGeometry ? pGeometry->positions : std::span<const Vector3>{ positions }; }
+		std::span<const Vector3> GetNormals() const { return pGeometry ? pGeometry->normals : std::span<const Vector3>{ normals }; }
+		std::span<const int> GetIndices() const { return pGeometry ? pGeometry->indices : std::span<const int>{ indices }; }
+
+		void SetGeometry(std::shared_ptr<const MeshGeometry> pNewGeometry)
+		{
+			pGeometry = std::move(pNewGeometry);
+			positions.clear();
+			normals.clear();
+			indices.clear();
+
+			UpdateAABB();
+		}
+
 		void AppendTriangle(const Triangle& triangle, bool ignoreTransformUpdate = false)
 		{
 			int startIndex = static_cast<int>(positions.size());
@@ -163,47 +212,26 @@ namespace dae
 
 		void UpdateTransforms()
 		{
-			//Clear all existing transformed
-			transformedPositions.clear();
-			transformedNormals.clear();
-
-			//Reserve capacity equal to amount of triangles
-			transformedPositions.reserve(positions.size());
-			transformedNormals.reserve(normals.size());
-
-			//Resize equal to amount
-			//transformedPositions.resize(positions.size());
-			//transformedNormals.resize(normals.size());
-
 			//Calculate Final Transform 
-			const Matrix finalTransform = scaleTransform * rotationTransform * translationTransform;
-
-			//Transform Positions (positions > transformedPositions)
-			//for (size_t i{}; i < positions.size(); ++i)
-			//{
-			//	transformedPositions[i] = std::move(finalTransform.TransformPoint(positions[i]));
-			//}
-			for (const Vector3& pos : positions)
-			{
-				transformedPositions.emplace_back(finalTransform.TransformPoint(pos));
-			}
-
-			//Transform Normals (normals > transformedNormals)
-			//for (size_t i{}; i < normals.size(); ++i)
-			//{
-			//	transformedNormals[i] = std::move(finalTransform.TransformVector(normals[i]));
-			//}
-			for (const Vector3& n : normals)
-			{
-				transformedNormals.emplace_back(finalTransform.TransformVector(n));
-			}
+			worldTransform = scaleTransform * rotationTransform * translationTransform;
+			inverseWorldTransform = Matrix::Inverse(worldTransform);
 
 			//Update AABB
-			UpdateTransformedAABB(finalTransform);
+			UpdateTransformedAABB(worldTransform);
+
+			++transformVersion;
 		}
 
 		void UpdateAABB()
 		{
+			//Precomputed
+			if (pGeometry)
+			{
+				minAABB = pGeometry->minAABB;
+				maxAABB = pGeometry->maxAABB;
+				return;
+			}
+
 			if (positions.size() > 0)
 			{
 				minAABB = positions[0];
@@ -291,6 +319,8 @@ namespace dae
 
 		bool didHit{ false };
 		unsigned char materialIndex{ 0 };
+		//Which object got hit, counting the spheres, planes and triangle meshes in that order
+		uint32_t objectIndex{ 0 };
 	};
 #pragma endregion
 }
\ No newline at end of file
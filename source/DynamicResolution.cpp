@@ -0,0 +1,53 @@
+#include "DynamicResolution.h"
+
+//Standard includes
+#include <algorithm>
+#include <cmath>
+
+using namespace dae;
+
+bool DynamicResolution::Update(float frameTime)
+{
+	//Ignore hitches like window drags or breakpoints
+	frameTime = std::min(frameTime, 1.f);
+
+	if (m_SmoothedFrameTime <= 0.f)
+		m_SmoothedFrameTime = frameTime;
+	else
+		m_SmoothedFrameTime += (frameTime - m_SmoothedFrameTime) * m_SmoothingFactor;
+
+	++m_FramesSinceChange;
+	if (m_FramesSinceChange < m_Cooldown)
+		return false;
+
+	const bool isTooSlow = m_SmoothedFrameTime > m_TargetFrameTime * m_DecreaseThreshold;
+	const bool isFastEnough = m_SmoothedFrameTime < m_TargetFrameTime * m_IncreaseThreshold;
+	if (!isTooSlow && !isFastEnough)
+		return false;
+
+	//Trace cost is proportional to the pixel count, which scales quadratically with the per axis scale
+	const float idealScale = m_Scale * std::sqrt(m_TargetFrameTime / m_SmoothedFrameTime);
+
+	//Round towards the current scale so a step up never overshoots the target (which would make it oscillate),
+	//a step down always goes at least one step so being slightly too slow doesn't get stuck
+	float newScale = isTooSlow
+		? std::min(std::ceil(idealScale / m_ScaleStep) * m_ScaleStep, m_Scale - m_ScaleStep)
+		: std::floor(idealScale / m_ScaleStep) * m_ScaleStep;
+	newScale = std::clamp(newScale, m_MinScale, m_MaxScale);
+
+	if (newScale == m_Scale)
+		return false;
+
+	//Predict the frame time at the new scale so the next decision doesn't depend on stale history
+	m_SmoothedFrameTime *= (newScale * newScale) / (m_Scale * m_Scale);
+	m_Scale = newScale;
+	m_FramesSinceChange = 0;
+	return true;
+}
+
+void DynamicResolution::Reset()
+{
+	m_Scale = m_MaxScale;
+	m_SmoothedFrameTime = 0.f;
+	m_FramesSinceChange = 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+namespace dae
+{
+	//Picks a render scale (fraction of the window resolution per axis) that keeps the frame time close to a target
+	class DynamicResolution final
+	{
+	public:
+		DynamicResolution() = default;
+		~DynamicResolution() = default;
+
+		DynamicResolution(const DynamicResolution&) = delete;
+		DynamicResolution(DynamicResolution&&) noexcept = delete;
+		DynamicResolution& operator=(const DynamicResolution&) = delete;
+		DynamicResolution& operator=(DynamicResolution&&) noexcept = delete;
+
+		//Feed the duration of the last frame (seconds), returns true if the scale changed
+		bool Update(float frameTime);
+		void Reset();
+
+		float GetScale() const { return m_Scale; }
+		float GetTargetFrameTime() const { return m_TargetFrameTime; }
+		void SetTargetFrameTime(float targetFrameTime) { m_TargetFrameTime = targetFrameTime; }
+
+	private:
+		float m_TargetFrameTime{ 1.f / 30.f };
+		float m_Scale{ 1.f };
+		float m_SmoothedFrameTime{ 0.f };
+		int m_FramesSinceChange{ 0 };
+
+		//Frame time is smoothed with an exponential moving average
+		static constexpr float m_SmoothingFactor{ 0.15f };
+		//Hysteresis: only scale down above 110% of the target and only scale up below 80% of it
+		static constexpr float m_DecreaseThreshold{ 1.1f };
+		static constexpr float m_IncreaseThreshold{ 0.8f };
+		//Frames to wait after a change before the smoothed frame time is trusted again
+		static constexpr int m_Cooldown{ 8 };
+		//Scales are quantized to avoid resizing over tiny differences
+		static constexpr float m_ScaleStep{ 1.f / 16.f };
+		static constexpr float m_MinScale{ 0.25f };
+		static constexpr float m_MaxScale{ 1.f };
+	};
+}
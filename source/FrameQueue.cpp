@@ -0,0 +1,117 @@
+#include "FrameQueue.h"
+
+//Standard includes
+#include <algorithm>
+
+using namespace dae;
+
+void Frame::ToRGB(std::vector<uint8_t>& rgbPixels) const
+{
+	rgbPixels.resize(pixels.size() * 3);
+	for (size_t i{ 0 }; i < pixels.size(); ++i)
+	{
+		const uint32_t pixel = pixels[i];
+		rgbPixels[i * 3] = static_cast<uint8_t>(pixel >> layout.redShift);
+		rgbPixels[i * 3 + 1] = static_cast<uint8_t>(pixel >> layout.greenShift);
+		rgbPixels[i * 3 + 2] = static_cast<uint8_t>(pixel >> layout.blueShift);
+	}
+}
+
+FrameQueue::FrameQueue(FrameHandler handler, uint32_t nrBuffers) :
+	m_Handler(std::move(handler))
+{
+	nrBuffers = std::max(nrBuffers, 1u);
+	for (uint32_t i{ 0 }; i < nrBuffers; ++i)
+	{
+		m_FreeFrames.push_back(std::make_unique<Frame>());
+	}
+
+	m_Thread = std::thread(&FrameQueue::WorkerLoop, this);
+}
+
+FrameQueue::~FrameQueue()
+{
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_IsStopping = true;
+	}
+	m_Condition.notify_all();
+
+	m_Thread.join();
+}
+
+void FrameQueue::Push(const uint32_t* pPixels, uint32_t width, uint32_t height, const PixelLayout& layout)
+{
+	std::unique_ptr<Frame> pFrame{};
+	{
+		//Back-pressure: wait until the handler gave a buffer back
+		std::unique_lock lock{ m_Mutex };
+		m_Condition.wait(lock, [this] { return !m_FreeFrames.empty(); });
+
+		pFrame = std::move(m_FreeFrames.back());
+		m_FreeFrames.pop_back();
+		pFrame->index = m_NrPushedFrames++;
+	}
+
+	//Pooled buffers keep their capacity, so this is only a copy after the first few frames
+	pFrame->pixels.assign(pPixels, pPixels + static_cast<size_t>(width) * height);
+	pFrame->width = width;
+	pFrame->height = height;
+	pFrame->layout = layout;
+
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_QueuedFrames.push_back(std::move(pFrame));
+	}
+	m_Condition.notify_all();
+}
+
+void FrameQueue::Flush()
+{
+	std::unique_lock lock{ m_Mutex };
+	m_Condition.wait(lock, [this] { return m_QueuedFrames.empty() && !m_IsHandlingFrame; });
+}
+
+uint64_t FrameQueue::GetNrPushedFrames() const
+{
+	std::lock_guard lock{ m_Mutex };
+	return m_NrPushedFrames;
+}
+
+uint64_t FrameQueue::GetNrFailedFrames() const
+{
+	std::lock_guard lock{ m_Mutex };
+	return m_NrFailedFrames;
+}
+
+void FrameQueue::WorkerLoop()
+{
+	while (true)
+	{
+		std::unique_ptr<Frame> pFrame{};
+		{
+			std::unique_lock lock{ m_Mutex };
+			m_Condition.wait(lock, [this] { return m_IsStopping || !m_QueuedFrames.empty(); });
+
+			//Finish queued frames before shutting down
+			if (m_QueuedFrames.empty())
+				return;
+
+			pFrame = std::move(m_QueuedFrames.front());
+			m_QueuedFrames.pop_front();
+			m_IsHandlingFrame = true;
+		}
+
+		const bool isHandled = m_Handler(*pFrame);
+
+		{
+			std::lock_guard lock{ m_Mutex };
+			if (!isHandled)
+				++m_NrFailedFrames;
+
+			m_FreeFrames.push_back(std::move(pFrame));
+			m_IsHandlingFrame = false;
+		}
+		m_Condition.notify_all();
+	}
+}
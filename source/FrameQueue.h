@@ -0,0 +1,77 @@
+#pragma once
+
+//Standard includes
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	//Bit positions of the 8 bit channels in a packed 32 bit pixel
+	struct PixelLayout
+	{
+		uint32_t redShift{ 16 };
+		uint32_t greenShift{ 8 };
+		uint32_t blueShift{ 0 };
+	};
+
+	//Copy of a finished frame
+	struct Frame
+	{
+		std::vector<uint32_t> pixels{};
+		uint32_t width{};
+		uint32_t height{};
+		PixelLayout layout{};
+		//Order in which the frame was pushed, starting at 0
+		uint64_t index{};
+
+		//Unpacks to tightly packed 8 bit RGB triplets
+		void ToRGB(std::vector<uint8_t>& rgbPixels) const;
+	};
+
+	//Hands frames to a handler running on its own thread (encoding, file or pipe I/O...).
+	//Frames are copied into a fixed pool of buffers, when all of them are waiting on the handler Push blocks (back-pressure)
+	class FrameQueue final
+	{
+	public:
+		//Returns false if the frame couldn't be written
+		using FrameHandler = std::function<bool(const Frame&)>;
+
+		explicit FrameQueue(FrameHandler handler, uint32_t nrBuffers = 4);
+		//Handles every frame that is still queued before returning
+		~FrameQueue();
+
+		FrameQueue(const FrameQueue&) = delete;
+		FrameQueue(FrameQueue&&) noexcept = delete;
+		FrameQueue& operator=(const FrameQueue&) = delete;
+		FrameQueue& operator=(FrameQueue&&) noexcept = delete;
+
+		void Push(const uint32_t* pPixels, uint32_t width, uint32_t height, const PixelLayout& layout);
+		//Blocks until every pushed frame is handled
+		void Flush();
+
+		uint64_t GetNrPushedFrames() const;
+		uint64_t GetNrFailedFrames() const;
+
+	private:
+		FrameHandler m_Handler{};
+
+		std::vector<std::unique_ptr<Frame>> m_FreeFrames{};
+		std::deque<std::unique_ptr<Frame>> m_QueuedFrames{};
+		uint64_t m_NrPushedFrames{ 0 };
+		uint64_t m_NrFailedFrames{ 0 };
+		bool m_IsHandlingFrame{ false };
+		bool m_IsStopping{ false };
+
+		mutable std::mutex m_Mutex{};
+		std::condition_variable m_Condition{};
+		std::thread m_Thread{};
+
+		void WorkerLoop();
+	};
+}
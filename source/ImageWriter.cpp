@@ -0,0 +1,357 @@
+#include "ImageWriter.h"
+
+//Standard includes
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+using namespace dae;
+
+namespace
+{
+	constexpr std::array<uint32_t, 256> g_Crc32Table = []
+		{
+			std::array<uint32_t, 256> table{};
+			for (uint32_t i{ 0 }; i < 256; ++i)
+			{
+				uint32_t crc = i;
+				for (int bit{ 0 }; bit < 8; ++bit)
+				{
+					crc = (crc & 1) ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+				}
+				table[i] = crc;
+			}
+			return table;
+		}();
+
+	uint32_t UpdateCrc32(uint32_t crc, const uint8_t* pData, size_t size)
+	{
+		for (size_t i{ 0 }; i < size; ++i)
+		{
+			crc = g_Crc32Table[(crc ^ pData[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return crc;
+	}
+
+	void AppendBigEndian(std::vector<uint8_t>& data, uint32_t value)
+	{
+		data.push_back(static_cast<uint8_t>(value >> 24));
+		data.push_back(static_cast<uint8_t>(value >> 16));
+		data.push_back(static_cast<uint8_t>(value >> 8));
+		data.push_back(static_cast<uint8_t>(value));
+	}
+
+	void WritePNGChunk(std::ofstream& file, const char type[4], const std::vector<uint8_t>& data)
+	{
+		std::vector<uint8_t> header{};
+		AppendBigEndian(header, static_cast<uint32_t>(data.size()));
+		header.insert(header.end(), type, type + 4);
+
+		//The CRC covers the type and the data, not the length
+		uint32_t crc = UpdateCrc32(0xFFFFFFFFu, header.data() + 4, 4);
+		crc = UpdateCrc32(crc, data.data(), data.size()) ^ 0xFFFFFFFFu;
+
+		std::vector<uint8_t> footer{};
+		AppendBigEndian(footer, crc);
+
+		file.write(reinterpret_cast<const char*>(header.data()), header.size());
+		file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		file.write(reinterpret_cast<const char*>(footer.data()), footer.size());
+	}
+
+	template<typename T>
+	void WriteValue(std::ofstream& file, const T& value)
+	{
+		//EXR is little endian, like every platform this builds for
+		file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	void WriteEXRAttribute(std::ofstream& file, const char* name, const char* type, int32_t size)
+	{
+		file.write(name, std::char_traits<char>::length(name) + 1);
+		file.write(type, std::char_traits<char>::length(type) + 1);
+		WriteValue(file, size);
+	}
+}
+
+ImageStripWriter::ImageStripWriter(const std::string& filename, ImageFormat format, uint32_t width, uint32_t height) :
+	m_File{ filename, std::ios::binary | std::ios::trunc },
+	m_Format{ format },
+	m_Width{ width },
+	m_Height{ height }
+{
+	if (m_File)
+		WriteHeader();
+}
+
+bool ImageStripWriter::TryGetFormat(const std::string& filename, ImageFormat& format)
+{
+	const size_t dotPosition = filename.find_last_of('.');
+	std::string extension = dotPosition == std::string::npos ? std::string{} : filename.substr(dotPosition + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+	if (extension == "ppm")
+		format = ImageFormat::PPM;
+	else if (extension == "png")
+		format = ImageFormat::PNG;
+	else if (extension == "exr")
+		format = ImageFormat::EXR;
+	else
+		return false;
+
+	return true;
+}
+
+void ImageStripWriter::WriteHeader()
+{
+	switch (m_Format)
+	{
+	case ImageFormat::PPM:
+		m_File << "P6\n" << m_Width << ' ' << m_Height << "\n255\n";
+		break;
+
+	case ImageFormat::PNG:
+	{
+		constexpr uint8_t signature[8]{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		m_File.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+		//8 bit RGB, no interlacing
+		std::vector<uint8_t> header{};
+		AppendBigEndian(header, m_Width);
+		AppendBigEndian(header, m_Height);
+		header.insert(header.end(), { 8, 2, 0, 0, 0 });
+		WritePNGChunk(m_File, "IHDR", header);
+		break;
+	}
+
+	case ImageFormat::EXR:
+	{
+		//Magic number and version 2, single part scanline image
+		WriteValue(m_File, int32_t{ 20000630 });
+		WriteValue(m_File, int32_t{ 2 });
+
+		//Channels have to be sorted by name: B, G, R, all 32 bit float (pixel type 2)
+		constexpr const char* channelNames[3]{ "B", "G", "R" };
+		WriteEXRAttribute(m_File, "channels", "chlist", 3 * 18 + 1);
+		for (const char* pName : channelNames)
+		{
+			m_File.write(pName, 2);
+			WriteValue(m_File, int32_t{ 2 }); //Pixel type
+			WriteValue(m_File, int32_t{ 0 }); //pLinear + reserved
+			WriteValue(m_File, int32_t{ 1 }); //x sampling
+			WriteValue(m_File, int32_t{ 1 }); //y sampling
+		}
+		m_File.put('\0');
+
+		WriteEXRAttribute(m_File, "compression", "compression", 1);
+		m_File.put('\0'); //No compression
+
+		const int32_t window[4]{ 0, 0, static_cast<int32_t>(m_Width) - 1, static_cast<int32_t>(m_Height) - 1 };
+		WriteEXRAttribute(m_File, "dataWindow", "box2i", sizeof(window));
+		WriteValue(m_File, window);
+		WriteEXRAttribute(m_File, "displayWindow", "box2i", sizeof(window));
+		WriteValue(m_File, window);
+
+		WriteEXRAttribute(m_File, "lineOrder", "lineOrder", 1);
+		m_File.put('\0'); //Increasing Y
+
+		WriteEXRAttribute(m_File, "pixelAspectRatio", "float", 4);
+		WriteValue(m_File, 1.f);
+
+		const float screenWindowCenter[2]{ 0.f, 0.f };
+		WriteEXRAttribute(m_File, "screenWindowCenter", "v2f", sizeof(screenWindowCenter));
+		WriteValue(m_File, screenWindowCenter);
+
+		WriteEXRAttribute(m_File, "screenWindowWidth", "float", 4);
+		WriteValue(m_File, 1.f);
+
+		//End of header
+		m_File.put('\0');
+
+		//Offset table, one block per scanline: y, data size, then the row of every channel
+		const uint64_t blockSize = 2 * sizeof(int32_t) + uint64_t{ m_Width } * 3 * sizeof(float);
+		const uint64_t firstBlockOffset = static_cast<uint64_t>(m_File.tellp()) + uint64_t{ m_Height } * sizeof(uint64_t);
+		for (uint32_t y{ 0 }; y < m_Height; ++y)
+		{
+			WriteValue(m_File, firstBlockOffset + uint64_t{ y } * blockSize);
+		}
+		break;
+	}
+	}
+}
+
+bool ImageStripWriter::WriteRows(const uint8_t* pPixels, uint32_t nrRows)
+{
+	if (m_Format != ImageFormat::EXR)
+		return WriteRGB8Rows(pPixels, nrRows);
+
+	m_ConvertedFloatRows.resize(static_cast<size_t>(m_Width) * nrRows * 3);
+	std::transform(pPixels, pPixels + m_ConvertedFloatRows.size(), m_ConvertedFloatRows.begin(), [](uint8_t value) { return value / 255.f; });
+	return WriteFloatRows(m_ConvertedFloatRows.data(), nrRows);
+}
+
+bool ImageStripWriter::WriteRows(const float* pPixels, uint32_t nrRows)
+{
+	if (m_Format == ImageFormat::EXR)
+		return WriteFloatRows(pPixels, nrRows);
+
+	m_ConvertedRows.resize(static_cast<size_t>(m_Width) * nrRows * 3);
+	std::transform(pPixels, pPixels + m_ConvertedRows.size(), m_ConvertedRows.begin(),
+		[](float value) { return static_cast<uint8_t>(std::clamp(value, 0.f, 1.f) * 255.f); });
+	return WriteRGB8Rows(m_ConvertedRows.data(), nrRows);
+}
+
+bool ImageStripWriter::WriteRGB8Rows(const uint8_t* pPixels, uint32_t nrRows)
+{
+	nrRows = std::min(nrRows, m_Height - m_NrWrittenRows);
+	const size_t rowSize = static_cast<size_t>(m_Width) * 3;
+
+	if (m_Format == ImageFormat::PPM)
+	{
+		m_File.write(reinterpret_cast<const char*>(pPixels), static_cast<std::streamsize>(rowSize * nrRows));
+		m_NrWrittenRows += nrRows;
+		return static_cast<bool>(m_File);
+	}
+
+	//PNG: every strip becomes one IDAT chunk, holding the next part of a single zlib stream made of stored deflate blocks
+	if (nrRows == 0)
+		return static_cast<bool>(m_File);
+
+	//Every row starts with its filter type (0, none)
+	m_FilteredRows.clear();
+	m_FilteredRows.reserve((rowSize + 1) * nrRows);
+	for (uint32_t y{ 0 }; y < nrRows; ++y)
+	{
+		m_FilteredRows.push_back(0);
+		m_FilteredRows.insert(m_FilteredRows.end(), pPixels + y * rowSize, pPixels + (y + 1) * rowSize);
+	}
+
+	//Adler-32 of the uncompressed data, continued over all strips
+	for (const uint8_t value : m_FilteredRows)
+	{
+		m_AdlerA = (m_AdlerA + value) % 65521;
+		m_AdlerB = (m_AdlerB + m_AdlerA) % 65521;
+	}
+
+	m_ChunkData.clear();
+	if (m_NrWrittenRows == 0)
+	{
+		m_ChunkData.push_back(0x78);
+		m_ChunkData.push_back(0x01);
+	}
+
+	//Stored blocks hold at most 65535 bytes each, only the very last one of the image is marked final
+	m_NrWrittenRows += nrRows;
+	const bool isLastStrip = m_NrWrittenRows == m_Height;
+	constexpr size_t maxBlockSize{ 65535 };
+
+	size_t offset{ 0 };
+	do
+	{
+		const size_t blockSize = std::min(maxBlockSize, m_FilteredRows.size() - offset);
+		const bool isFinalBlock = isLastStrip && offset + blockSize == m_FilteredRows.size();
+
+		m_ChunkData.push_back(isFinalBlock ? 1 : 0);
+		m_ChunkData.push_back(static_cast<uint8_t>(blockSize));
+		m_ChunkData.push_back(static_cast<uint8_t>(blockSize >> 8));
+		m_ChunkData.push_back(static_cast<uint8_t>(~blockSize));
+		m_ChunkData.push_back(static_cast<uint8_t>(~blockSize >> 8));
+		m_ChunkData.insert(m_ChunkData.end(), m_FilteredRows.begin() + offset, m_FilteredRows.begin() + offset + blockSize);
+
+		offset += blockSize;
+	} while (offset < m_FilteredRows.size());
+
+	if (isLastStrip)
+		AppendBigEndian(m_ChunkData, (m_AdlerB << 16) | m_AdlerA);
+
+	WritePNGChunk(m_File, "IDAT", m_ChunkData);
+	return static_cast<bool>(m_File);
+}
+
+bool ImageStripWriter::WriteFloatRows(const float* pPixels, uint32_t nrRows)
+{
+	nrRows = std::min(nrRows, m_Height - m_NrWrittenRows);
+	const int32_t blockDataSize = static_cast<int32_t>(m_Width * 3 * sizeof(float));
+
+	std::vector<float> channelRow(m_Width);
+	for (uint32_t y{ 0 }; y < nrRows; ++y)
+	{
+		WriteValue(m_File, static_cast<int32_t>(m_NrWrittenRows + y));
+		WriteValue(m_File, blockDataSize);
+
+		const float* pRow = pPixels + static_cast<size_t>(y) * m_Width * 3;
+		for (const int channel : { 2, 1, 0 })
+		{
+			for (uint32_t x{ 0 }; x < m_Width; ++x)
+			{
+				channelRow[x] = pRow[x * 3 + channel];
+			}
+			m_File.write(reinterpret_cast<const char*>(channelRow.data()), m_Width * sizeof(float));
+		}
+	}
+
+	m_NrWrittenRows += nrRows;
+	return static_cast<bool>(m_File);
+}
+
+bool ImageStripWriter::Close()
+{
+	if (!m_File.is_open())
+		return false;
+
+	if (m_Format == ImageFormat::PNG && m_NrWrittenRows == m_Height)
+		WritePNGChunk(m_File, "IEND", {});
+
+	const bool isComplete = m_NrWrittenRows == m_Height && static_cast<bool>(m_File);
+	m_File.close();
+	return isComplete;
+}
+
+bool ImageWriter::WritePPM(const std::string& filename, const uint8_t* pPixels, uint32_t width, uint32_t height)
+{
+	ImageStripWriter writer{ filename, ImageFormat::PPM, width, height };
+	return writer.WriteRows(pPixels, height) && writer.Close();
+}
+
+bool ImageWriter::WritePNG(const std::string& filename, const uint8_t* pPixels, uint32_t width, uint32_t height)
+{
+	ImageStripWriter writer{ filename, ImageFormat::PNG, width, height };
+	return writer.WriteRows(pPixels, height) && writer.Close();
+}
+
+bool ImageWriter::WriteEXR(const std::string& filename, const float* pPixels, uint32_t width, uint32_t height)
+{
+	ImageStripWriter writer{ filename, ImageFormat::EXR, width, height };
+	return writer.WriteRows(pPixels, height) && writer.Close();
+}
+
+bool ImageWriter::Write(const std::string& filename, const uint8_t* pPixels, uint32_t width, uint32_t height)
+{
+	ImageFormat format{};
+	if (!ImageStripWriter::TryGetFormat(filename, format))
+		return false;
+
+	ImageStripWriter writer{ filename, format, width, height };
+	return writer.WriteRows(pPixels, height) && writer.Close();
+}
+
+FrameQueue::FrameHandler ImageWriter::CreateSequenceWriter(const std::string& prefix, const std::string& extension)
+{
+	return [prefix, extension, nextNumber = uint32_t{ 0 }, rgbPixels = std::vector<uint8_t>{}](const Frame& frame) mutable
+		{
+			std::string filename{};
+			do
+			{
+				char number[16]{};
+				std::snprintf(number, sizeof(number), "_%04u.", nextNumber++);
+				filename = prefix + number + extension;
+			} while (std::filesystem::exists(filename));
+
+			frame.ToRGB(rgbPixels);
+			return Write(filename, rgbPixels.data(), frame.width, frame.height);
+		};
+}
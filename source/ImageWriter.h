@@ -0,0 +1,85 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//Project includes
+#include "FrameQueue.h"
+
+namespace dae
+{
+	enum class ImageFormat
+	{
+		PPM,
+		PNG,
+		EXR
+	};
+
+	//Writes an image a strip of rows at a time, top to bottom, so the whole image never has to be in memory.
+	//All three formats have a fixed size per row, so every header (and the EXR offset table) can be written up front
+	class ImageStripWriter final
+	{
+	public:
+		ImageStripWriter(const std::string& filename, ImageFormat format, uint32_t width, uint32_t height);
+		~ImageStripWriter() = default;
+
+		ImageStripWriter(const ImageStripWriter&) = delete;
+		ImageStripWriter(ImageStripWriter&&) noexcept = delete;
+		ImageStripWriter& operator=(const ImageStripWriter&) = delete;
+		ImageStripWriter& operator=(ImageStripWriter&&) noexcept = delete;
+
+		//Picks the format from the extension (.ppm, .png or .exr)
+		static bool TryGetFormat(const std::string& filename, ImageFormat& format);
+
+		bool IsOpen() const { return m_File.is_open(); }
+
+		//pPixels holds nrRows full rows of tightly packed 8 bit RGB triplets, mapped to [0, 1] for EXR
+		bool WriteRows(const uint8_t* pPixels, uint32_t nrRows);
+		//pPixels holds nrRows full rows of linear float RGB triplets, clamped to [0, 1] for PPM and PNG
+		bool WriteRows(const float* pPixels, uint32_t nrRows);
+		//Finishes the file, returns false if any write failed or not every row was written
+		bool Close();
+
+	private:
+		std::ofstream m_File{};
+		ImageFormat m_Format{};
+		uint32_t m_Width{};
+		uint32_t m_Height{};
+		uint32_t m_NrWrittenRows{ 0 };
+
+		//Running zlib checksum over every PNG row (filter byte included)
+		uint32_t m_AdlerA{ 1 };
+		uint32_t m_AdlerB{ 0 };
+
+		//Reused between strips: rows converted to the other pixel type, PNG rows with their filter byte and the chunk being built
+		std::vector<uint8_t> m_ConvertedRows{};
+		std::vector<float> m_ConvertedFloatRows{};
+		std::vector<uint8_t> m_FilteredRows{};
+		std::vector<uint8_t> m_ChunkData{};
+
+		void WriteHeader();
+		bool WriteRGB8Rows(const uint8_t* pPixels, uint32_t nrRows);
+		bool WriteFloatRows(const float* pPixels, uint32_t nrRows);
+	};
+
+	//Dependency free image output, all functions return false if the file couldn't be written
+	namespace ImageWriter
+	{
+		//pPixels holds width * height tightly packed 8 bit RGB triplets, top row first
+		bool WritePPM(const std::string& filename, const uint8_t* pPixels, uint32_t width, uint32_t height);
+		//Stored (uncompressed) deflate blocks, so no zlib is needed. Files are about as large as the raw pixels
+		bool WritePNG(const std::string& filename, const uint8_t* pPixels, uint32_t width, uint32_t height);
+		//pPixels holds width * height linear float RGB triplets, written as an uncompressed 32 bit float scanline image
+		bool WriteEXR(const std::string& filename, const float* pPixels, uint32_t width, uint32_t height);
+
+		//Picks the format from the extension (.ppm, .png or .exr), 8 bit values are mapped to [0, 1] for EXR
+		bool Write(const std::string& filename, const uint8_t* pPixels, uint32_t width, uint32_t height);
+
+		//FrameQueue handler that writes every frame to the next free <prefix>_0000.<extension>, <prefix>_0001.<extension>, ...
+		//Numbers that already exist on disk are skipped, so earlier screenshots or recordings are never overwritten
+		FrameQueue::FrameHandler CreateSequenceWriter(const std::string& prefix, const std::string& extension);
+	}
+}
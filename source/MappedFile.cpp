@@ -0,0 +1,89 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace dae;
+
+MappedFile::MappedFile(const std::string& filename)
+{
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	m_FileHandle = file;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size))
+		return;
+
+	m_IsOpen = true;
+	m_Size = static_cast<size_t>(size.QuadPart);
+
+	//Mapping an empty file fails
+	if (m_Size == 0)
+		return;
+
+	m_MappingHandle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_MappingHandle)
+		m_pData = static_cast<const char*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+
+	if (!m_pData)
+	{
+		m_IsOpen = false;
+		m_Size = 0;
+	}
+#else
+	const int file = open(filename.c_str(), O_RDONLY);
+	if (file == -1)
+		return;
+
+	struct stat fileStats{};
+	if (fstat(file, &fileStats) == 0)
+	{
+		m_IsOpen = true;
+		m_Size = static_cast<size_t>(fileStats.st_size);
+
+		if (m_Size > 0)
+		{
+			void* pData = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, file, 0);
+			if (pData != MAP_FAILED)
+			{
+				madvise(pData, m_Size, MADV_SEQUENTIAL);
+				m_pData = static_cast<const char*>(pData);
+			}
+			else
+			{
+				m_IsOpen = false;
+				m_Size = 0;
+			}
+		}
+	}
+
+	//The mapping stays valid after the descriptor is closed
+	close(file);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(_WIN32)
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_MappingHandle)
+		CloseHandle(m_MappingHandle);
+	if (m_FileHandle)
+		CloseHandle(m_FileHandle);
+#else
+	if (m_pData)
+		munmap(const_cast<char*>(m_pData), m_Size);
+#endif
+}
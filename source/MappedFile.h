@@ -0,0 +1,36 @@
+#pragma once
+
+//Standard includes
+#include <cstddef>
+#include <string>
+
+namespace dae
+{
+	//Read-only memory mapping of a whole file, unmapped when destroyed
+	class MappedFile final
+	{
+	public:
+		explicit MappedFile(const std::string& filename);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile(MappedFile&&) noexcept = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		MappedFile& operator=(MappedFile&&) noexcept = delete;
+
+		//An empty file is open but has no data
+		bool IsOpen() const { return m_IsOpen; }
+		const char* GetData() const { return m_pData; }
+		size_t GetSize() const { return m_Size; }
+
+	private:
+		const char* m_pData{ nullptr };
+		size_t m_Size{ 0 };
+		bool m_IsOpen{ false };
+
+	#if defined(_WIN32)
+		void* m_FileHandle{ nullptr };
+		void* m_MappingHandle{ nullptr };
+	#endif
+	};
+}
@@ -82,6 +82,42 @@ namespace dae {
 		return out;
 	}
 
+	const Matrix& Matrix::Inverse()
+	{
+		//Only valid for affine matrices (translation, rotation, scale), which is all this project builds
+		const Vector3 xAxis{ GetAxisX() };
+		const Vector3 yAxis{ GetAxisY() };
+		const Vector3 zAxis{ GetAxisZ() };
+
+		//The inverse of the 3x3 part is its adjugate divided by the determinant, the adjugate's columns are these cross products
+		const Vector3 crossYZ{ Vector3::Cross(yAxis, zAxis) };
+		const Vector3 crossZX{ Vector3::Cross(zAxis, xAxis) };
+		const Vector3 crossXY{ Vector3::Cross(xAxis, yAxis) };
+
+		const float determinant{ Vector3::Dot(xAxis, crossYZ) };
+		assert(determinant != 0.f);
+		const float inverseDeterminant{ 1.f / determinant };
+
+		Matrix result{ crossYZ * inverseDeterminant, crossZX * inverseDeterminant, crossXY * inverseDeterminant, Vector3::Zero };
+		result.Transpose();
+		result[3] = { -result.TransformVector(GetTranslation()), 1.f };
+
+		data[0] = result[0];
+		data[1] = result[1];
+		data[2] = result[2];
+		data[3] = result[3];
+
+		return *this;
+	}
+
+	Matrix Matrix::Inverse(const Matrix& m)
+	{
+		Matrix out{ m };
+		out.Inverse();
+
+		return out;
+	}
+
 	Vector3 Matrix::GetAxisX() const
 	{
 		return data[0];
@@ -0,0 +1,307 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "ObjParser.h"
+#include "Utils.h"
+
+//Standard includes
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+using namespace dae;
+
+namespace
+{
+	constexpr uint64_t AlignOffset(uint64_t offset)
+	{
+		return (offset + MeshCacheHeader::Alignment - 1) / MeshCacheHeader::Alignment * MeshCacheHeader::Alignment;
+	}
+
+	//True if an array of the given size fits the file at an aligned offset
+	bool IsArrayValid(uint64_t offset, uint64_t size, uint64_t fileSize)
+	{
+		return offset % MeshCacheHeader::Alignment == 0 && offset <= fileSize && size <= fileSize - offset;
+	}
+
+	void WritePadding(std::ofstream& file, uint64_t& offset, uint64_t alignedOffset)
+	{
+		constexpr char padding[MeshCacheHeader::Alignment]{};
+		file.write(padding, static_cast<std::streamsize>(alignedOffset - offset));
+		offset = alignedOffset;
+	}
+
+	void WriteArray(std::ofstream& file, uint64_t& offset, const void* pData, uint64_t size)
+	{
+		file.write(static_cast<const char*>(pData), static_cast<std::streamsize>(size));
+		offset += size;
+		WritePadding(file, offset, AlignOffset(offset));
+	}
+
+	//Geometry that is currently alive, only weak references are kept so unused assets are freed with their last mesh
+	struct AssetRegistry
+	{
+		struct Entry
+		{
+			uint64_t sourceSize{};
+			int64_t sourceTime{};
+			std::weak_ptr<const MeshGeometry> pGeometry{};
+
+			//Set while a thread is loading this path, other threads wait for it instead of parsing the same file
+			std::shared_future<std::shared_ptr<const MeshGeometry>> loading{};
+			uint64_t loadId{};
+		};
+
+		std::mutex mutex{};
+		std::unordered_map<std::string, Entry> entriesByPath{};
+		std::unordered_map<uint64_t, std::weak_ptr<const MeshGeometry>> geometriesByHash{};
+		uint64_t nextLoadId{ 1 };
+	};
+
+	AssetRegistry& GetAssetRegistry()
+	{
+		static AssetRegistry registry{};
+		return registry;
+	}
+
+	template<typename T>
+	bool IsSameBytes(std::span<const T> a, std::span<const T> b)
+	{
+		return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size_bytes()) == 0);
+	}
+
+	//The hash only finds the candidate, two different meshes can still collide
+	bool IsSameContent(const MeshGeometry& a, const MeshGeometry& b)
+	{
+		return a.contentHash == b.contentHash && IsSameBytes(a.positions, b.positions) &&
+			IsSameBytes(a.normals, b.normals) && IsSameBytes(a.indices, b.indices);
+	}
+
+	std::shared_ptr<const MeshGeometry> LoadFromDisk(const std::string& objFilename, uint64_t sourceSize, int64_t sourceTime)
+	{
+		const std::string cacheFilename = objFilename + ".meshcache";
+		if (std::shared_ptr<const MeshGeometry> pCachedGeometry = MeshCache::Read(cacheFilename, sourceSize, sourceTime))
+			return pCachedGeometry;
+
+		//No (valid) cache yet, parse the OBJ and write one for next time
+		std::shared_ptr<MeshGeometry> pGeometry = std::make_shared<MeshGeometry>();
+		if (!ObjParser::Parse(objFilename, pGeometry->ownedPositions, pGeometry->ownedNormals, pGeometry->ownedIndices))
+			return nullptr;
+
+		pGeometry->positions = pGeometry->ownedPositions;
+		pGeometry->normals = pGeometry->ownedNormals;
+		pGeometry->indices = pGeometry->ownedIndices;
+
+		if (!pGeometry->positions.empty())
+		{
+			pGeometry->minAABB = pGeometry->positions[0];
+			pGeometry->maxAABB = pGeometry->positions[0];
+			for (const Vector3& position : pGeometry->positions)
+			{
+				pGeometry->minAABB = Vector3::Min(position, pGeometry->minAABB);
+				pGeometry->maxAABB = Vector3::Max(position, pGeometry->maxAABB);
+			}
+		}
+		pGeometry->contentHash = MeshCache::ComputeContentHash(*pGeometry);
+
+		//Not being able to write the cache (e.g. read-only folder) only costs the next startup
+		MeshCache::Write(cacheFilename, *pGeometry, sourceSize, sourceTime);
+		return pGeometry;
+	}
+}
+
+std::shared_ptr<const MeshGeometry> MeshCache::Load(const std::string& objFilename)
+{
+	std::error_code error{};
+	const uint64_t sourceSize = std::filesystem::file_size(objFilename, error);
+	if (error)
+		return nullptr;
+
+	const int64_t sourceTime = static_cast<int64_t>(std::filesystem::last_write_time(objFilename, error).time_since_epoch().count());
+	if (error)
+		return nullptr;
+
+	//Different spellings of the same path ("Resources/a.obj", "./Resources/a.obj") should find the same entry
+	std::string key = std::filesystem::weakly_canonical(objFilename, error).string();
+	if (error)
+		key = objFilename;
+
+	AssetRegistry& registry = GetAssetRegistry();
+	std::promise<std::shared_ptr<const MeshGeometry>> promise{};
+	uint64_t loadId{};
+	{
+		std::unique_lock lock{ registry.mutex };
+		AssetRegistry::Entry& entry = registry.entriesByPath[key];
+		if (entry.sourceSize == sourceSize && entry.sourceTime == sourceTime)
+		{
+			if (std::shared_ptr<const MeshGeometry> pGeometry = entry.pGeometry.lock())
+				return pGeometry;
+
+			if (entry.loading.valid())
+			{
+				std::shared_future<std::shared_ptr<const MeshGeometry>> loading = entry.loading;
+				lock.unlock();
+				return loading.get();
+			}
+		}
+
+		//New, changed or no longer used, this thread loads it
+		loadId = registry.nextLoadId++;
+		entry = { sourceSize, sourceTime, {}, promise.get_future().share(), loadId };
+	}
+
+	std::shared_ptr<const MeshGeometry> pGeometry{};
+	try
+	{
+		pGeometry = LoadFromDisk(objFilename, sourceSize, sourceTime);
+	}
+	catch (...)
+	{
+		//Threads waiting on this load get the same exception, and the next Load of the path tries again
+		{
+			std::lock_guard lock{ registry.mutex };
+			AssetRegistry::Entry& entry = registry.entriesByPath[key];
+			if (entry.loadId == loadId)
+				entry = {};
+		}
+
+		promise.set_exception(std::current_exception());
+		throw;
+	}
+
+	{
+		std::lock_guard lock{ registry.mutex };
+		if (pGeometry)
+		{
+			std::weak_ptr<const MeshGeometry>& pSameContent = registry.geometriesByHash[pGeometry->contentHash];
+			std::shared_ptr<const MeshGeometry> pExisting = pSameContent.lock();
+			if (pExisting && IsSameContent(*pExisting, *pGeometry))
+				pGeometry = std::move(pExisting);
+			else
+				pSameContent = pGeometry;
+		}
+
+		//Only finish the entry if no newer load (of a changed file) replaced it in the meantime
+		AssetRegistry::Entry& entry = registry.entriesByPath[key];
+		if (entry.loadId == loadId)
+		{
+			entry.pGeometry = pGeometry;
+			entry.loading = {};
+		}
+	}
+
+	promise.set_value(pGeometry);
+	return pGeometry;
+}
+
+std::shared_ptr<const MeshGeometry> MeshCache::Read(const std::string& cacheFilename, uint64_t sourceSize, int64_t sourceTime)
+{
+	std::shared_ptr<MappedFile> pFile = std::make_shared<MappedFile>(cacheFilename);
+	if (!pFile->IsOpen() || pFile->GetSize() < sizeof(MeshCacheHeader))
+		return nullptr;
+
+	//The mapping is page aligned, so the header and the aligned arrays can be used in place
+	const MeshCacheHeader& header = *reinterpret_cast<const MeshCacheHeader*>(pFile->GetData());
+	if (header.magic != MeshCacheHeader::Magic || header.version != MeshCacheHeader::CurrentVersion)
+		return nullptr;
+
+	if (header.sourceSize != sourceSize || header.sourceTime != sourceTime)
+		return nullptr;
+
+	const uint64_t fileSize = pFile->GetSize();
+	if (header.nrPositions > fileSize / sizeof(Vector3) || header.nrTriangles > fileSize / (3 * sizeof(int)) ||
+		!IsArrayValid(header.positionsOffset, header.nrPositions * sizeof(Vector3), fileSize) ||
+		!IsArrayValid(header.normalsOffset, header.nrTriangles * sizeof(Vector3), fileSize) ||
+		!IsArrayValid(header.indicesOffset, header.nrTriangles * 3 * sizeof(int), fileSize))
+	{
+		return nullptr;
+	}
+
+	//The arrays are used as they are, an index outside the positions would be read out of bounds while tracing
+	const std::span<const int> indices{ reinterpret_cast<const int*>(pFile->GetData() + header.indicesOffset), header.nrTriangles * 3 };
+	for (const int index : indices)
+	{
+		if (index < 0 || static_cast<uint64_t>(index) >= header.nrPositions)
+			return nullptr;
+	}
+
+	std::shared_ptr<MeshGeometry> pGeometry = std::make_shared<MeshGeometry>();
+	pGeometry->positions = { reinterpret_cast<const Vector3*>(pFile->GetData() + header.positionsOffset), header.nrPositions };
+	pGeometry->normals = { reinterpret_cast<const Vector3*>(pFile->GetData() + header.normalsOffset), header.nrTriangles };
+	pGeometry->indices = indices;
+	pGeometry->minAABB = { header.minAABB[0], header.minAABB[1], header.minAABB[2] };
+	pGeometry->maxAABB = { header.maxAABB[0], header.maxAABB[1], header.maxAABB[2] };
+	pGeometry->contentHash = header.contentHash;
+	pGeometry->pStorage = std::move(pFile);
+
+	return pGeometry;
+}
+
+bool MeshCache::Write(const std::string& cacheFilename, const MeshGeometry& geometry, uint64_t sourceSize, int64_t sourceTime)
+{
+	//The format stores exactly one normal per triangle
+	if (geometry.indices.size() % 3 != 0 || geometry.normals.size() != geometry.indices.size() / 3)
+		return false;
+
+	MeshCacheHeader header{};
+	header.sourceSize = sourceSize;
+	header.sourceTime = sourceTime;
+	header.contentHash = geometry.contentHash;
+	header.nrPositions = geometry.positions.size();
+	header.nrTriangles = geometry.indices.size() / 3;
+
+	header.positionsOffset = AlignOffset(sizeof(MeshCacheHeader));
+	header.normalsOffset = AlignOffset(header.positionsOffset + header.nrPositions * sizeof(Vector3));
+	header.indicesOffset = AlignOffset(header.normalsOffset + header.nrTriangles * sizeof(Vector3));
+	header.bvhOffset = AlignOffset(header.indicesOffset + header.nrTriangles * 3 * sizeof(int));
+
+	header.minAABB[0] = geometry.minAABB.x;
+	header.minAABB[1] = geometry.minAABB.y;
+	header.minAABB[2] = geometry.minAABB.z;
+	header.maxAABB[0] = geometry.maxAABB.x;
+	header.maxAABB[1] = geometry.maxAABB.y;
+	header.maxAABB[2] = geometry.maxAABB.z;
+
+	//Write next to the target and rename afterwards, so a reader never maps a half written cache
+	const std::string tempFilename = cacheFilename + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+	{
+		std::ofstream file{ tempFilename, std::ios::binary | std::ios::trunc };
+		if (!file)
+			return false;
+
+		uint64_t offset{ 0 };
+		WriteArray(file, offset, &header, sizeof(MeshCacheHeader));
+		WriteArray(file, offset, geometry.positions.data(), geometry.positions.size_bytes());
+		WriteArray(file, offset, geometry.normals.data(), header.nrTriangles * sizeof(Vector3));
+		WriteArray(file, offset, geometry.indices.data(), header.nrTriangles * 3 * sizeof(int));
+
+		if (!file)
+		{
+			file.close();
+			std::error_code error{};
+			std::filesystem::remove(tempFilename, error);
+			return false;
+		}
+	}
+
+	std::error_code error{};
+	std::filesystem::rename(tempFilename, cacheFilename, error);
+	if (error)
+	{
+		std::filesystem::remove(tempFilename, error);
+		return false;
+	}
+
+	return true;
+}
+
+uint64_t MeshCache::ComputeContentHash(const MeshGeometry& geometry)
+{
+	uint64_t hash = Utils::HashBytes(Utils::HASH_BASIS, geometry.positions.data(), geometry.positions.size_bytes());
+	hash = Utils::HashBytes(hash, geometry.normals.data(), geometry.normals.size_bytes());
+	return Utils::HashBytes(hash, geometry.indices.data(), geometry.indices.size_bytes());
+}
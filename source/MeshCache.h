@@ -0,0 +1,59 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+#include <memory>
+#include <string>
+
+//Project includes
+#include "DataTypes.h"
+
+namespace dae
+{
+	//Layout of a binary mesh cache file: this header followed by the arrays it points to.
+	//Positions and normals are stored as Vector3 (3 floats), indices as int (3 per triangle), all in native byte order
+	struct MeshCacheHeader
+	{
+		static constexpr uint32_t Magic{ 0x48534D44 }; //"DMSH"
+		static constexpr uint32_t CurrentVersion{ 2 };
+		static constexpr uint64_t Alignment{ 64 };
+
+		uint32_t magic{ Magic };
+		uint32_t version{ CurrentVersion };
+
+		//Size and last write time of the OBJ the cache was built from, a mismatch means the cache is outdated
+		uint64_t sourceSize{};
+		int64_t sourceTime{};
+		uint64_t contentHash{};
+
+		uint64_t nrPositions{};
+		uint64_t nrTriangles{};
+		//Reserved for an acceleration structure, always 0 for now
+		uint64_t nrBvhNodes{};
+
+		//Byte offsets from the start of the file, all multiples of Alignment
+		uint64_t positionsOffset{};
+		uint64_t normalsOffset{};
+		uint64_t indicesOffset{};
+		uint64_t bvhOffset{};
+
+		float minAABB[3]{};
+		float maxAABB[3]{};
+	};
+
+	namespace MeshCache
+	{
+		//Loads an OBJ through its binary cache (<filename>.meshcache). The cache is generated on the first load and regenerated
+		//when the OBJ changed, otherwise the arrays are used straight from the mapped file. Returns nullptr if the OBJ can't be read.
+		//Loaded assets are shared: while any mesh still holds the geometry of a path (or of an asset with the same content),
+		//loading it again returns that same geometry. Safe to call from multiple threads, concurrent loads of one path parse once
+		std::shared_ptr<const MeshGeometry> Load(const std::string& objFilename);
+
+		//Maps a cache file, returns nullptr if it's missing, invalid, from another format version or built from a different source
+		std::shared_ptr<const MeshGeometry> Read(const std::string& cacheFilename, uint64_t sourceSize, int64_t sourceTime);
+		bool Write(const std::string& cacheFilename, const MeshGeometry& geometry, uint64_t sourceSize, int64_t sourceTime);
+
+		//FNV-1a over the positions, normals and indices
+		uint64_t ComputeContentHash(const MeshGeometry& geometry);
+	}
+}
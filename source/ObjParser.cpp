@@ -0,0 +1,340 @@
+#include "ObjParser.h"
+#include "MappedFile.h"
+
+//Standard includes
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <numeric>
+#include <ppl.h> //parallel_for
+#include <thread>
+
+using namespace dae;
+
+namespace
+{
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+	}
+
+	inline const char* SkipSpaces(const char* p, const char* pEnd)
+	{
+		while (p < pEnd && IsSpace(*p))
+			++p;
+		return p;
+	}
+
+	inline const char* SkipToken(const char* p, const char* pEnd)
+	{
+		while (p < pEnd && !IsSpace(*p))
+			++p;
+		return p;
+	}
+
+	inline const char* FindLineEnd(const char* p, const char* pEnd)
+	{
+		const void* pNewLine = std::memchr(p, '\n', pEnd - p);
+		return pNewLine ? static_cast<const char*>(pNewLine) : pEnd;
+	}
+
+	//True if the line starts with the given command followed by whitespace
+	inline bool IsCommand(const char* p, const char* pLineEnd, char command)
+	{
+		return pLineEnd - p >= 2 && p[0] == command && IsSpace(p[1]);
+	}
+
+	inline bool ParseFloat(const char*& p, const char* pLineEnd, float& value)
+	{
+		p = SkipSpaces(p, pLineEnd);
+		//from_chars doesn't accept an explicit plus sign
+		if (p < pLineEnd && *p == '+')
+			++p;
+
+		const std::from_chars_result result = std::from_chars(p, pLineEnd, value);
+		if (result.ec != std::errc{})
+			return false;
+
+		p = result.ptr;
+		return true;
+	}
+
+	//Reads the position index of a face vertex (v, v/vt, v//vn or v/vt/vn) and skips the rest of the token
+	inline bool ParseFaceVertex(const char*& p, const char* pLineEnd, int& index)
+	{
+		p = SkipSpaces(p, pLineEnd);
+		if (p == pLineEnd)
+			return false;
+
+		const std::from_chars_result result = std::from_chars(p, pLineEnd, index);
+		p = SkipToken(result.ptr, pLineEnd);
+		return result.ec == std::errc{};
+	}
+
+	//Files below this size are parsed as a single chunk, the threading overhead isn't worth it
+	constexpr size_t g_MinChunkSize{ 1 << 20 };
+	//Meshes below this triangle count get their normals computed on the calling thread
+	constexpr size_t g_MinParallelNormalsTriangles{ 1 << 16 };
+
+	//Counts the vertex and face lines so the output can be allocated once (polygons may still grow the index buffer)
+	void PreScan(const char* p, const char* pEnd, size_t& nrPositions, size_t& nrFaces)
+	{
+		nrPositions = 0;
+		nrFaces = 0;
+
+		while (p < pEnd)
+		{
+			const char* pLineEnd = FindLineEnd(p, pEnd);
+			const char* pLine = SkipSpaces(p, pLineEnd);
+
+			if (IsCommand(pLine, pLineEnd, 'v'))
+				++nrPositions;
+			else if (IsCommand(pLine, pLineEnd, 'f'))
+				++nrFaces;
+
+			p = pLineEnd + 1;
+		}
+	}
+
+	//Output of a line aligned part of the file
+	struct Chunk
+	{
+		const char* pBegin{};
+		const char* pEnd{};
+
+		std::vector<Vector3> positions{};
+		std::vector<int> indices{};
+		//Slots in indices that came from negative indices, these are local to the chunk and still need its position offset
+		std::vector<size_t> relativeIndexSlots{};
+
+		size_t positionOffset{};
+		size_t indexOffset{};
+		bool isValid{ true };
+	};
+
+	void ParseChunk(Chunk& chunk)
+	{
+		size_t nrPositions{}, nrFaces{};
+		PreScan(chunk.pBegin, chunk.pEnd, nrPositions, nrFaces);
+		chunk.positions.reserve(nrPositions);
+		chunk.indices.reserve(nrFaces * 3);
+
+		const char* p = chunk.pBegin;
+		while (p < chunk.pEnd)
+		{
+			const char* pLineEnd = FindLineEnd(p, chunk.pEnd);
+			const char* pLine = SkipSpaces(p, pLineEnd);
+
+			if (IsCommand(pLine, pLineEnd, 'v'))
+			{
+				//Vertex
+				++pLine;
+				Vector3 position{};
+				if (!ParseFloat(pLine, pLineEnd, position.x) ||
+					!ParseFloat(pLine, pLineEnd, position.y) ||
+					!ParseFloat(pLine, pLineEnd, position.z))
+				{
+					//Skipping it would shift every index that comes after
+					chunk.isValid = false;
+					return;
+				}
+
+				chunk.positions.push_back(position);
+			}
+			else if (IsCommand(pLine, pLineEnd, 'f'))
+			{
+				//Face, polygons are triangulated as a fan around the first vertex
+				++pLine;
+				int faceIndices[3]{};
+				bool isRelative[3]{};
+				int nrVertices{ 0 };
+				int index{};
+				while (ParseFaceVertex(pLine, pLineEnd, index))
+				{
+					if (index == 0)
+					{
+						chunk.isValid = false;
+						return;
+					}
+
+					//Positive indices are 1-based and global, negative ones are relative to the last vertex read so far.
+					//Those are made local to the chunk here and rebased once the vertex counts of the previous chunks are known
+					const bool isIndexRelative = index < 0;
+					index = isIndexRelative ? index + static_cast<int>(chunk.positions.size()) : index - 1;
+
+					if (nrVertices < 2)
+					{
+						faceIndices[nrVertices] = index;
+						isRelative[nrVertices] = isIndexRelative;
+					}
+					else
+					{
+						faceIndices[2] = index;
+						isRelative[2] = isIndexRelative;
+
+						for (int i{ 0 }; i < 3; ++i)
+						{
+							if (isRelative[i])
+								chunk.relativeIndexSlots.push_back(chunk.indices.size());
+							chunk.indices.push_back(faceIndices[i]);
+						}
+
+						//Next triangle of the fan reuses the first and current vertex
+						faceIndices[1] = faceIndices[2];
+						isRelative[1] = isRelative[2];
+					}
+
+					++nrVertices;
+				}
+			}
+			//Everything else (comments, vt, vn, groups, materials...) is ignored
+
+			p = pLineEnd + 1;
+		}
+	}
+
+	//Splits [pBegin, pEnd) into nrChunks parts that each end right after a newline
+	std::vector<Chunk> SplitChunks(const char* pBegin, const char* pEnd, size_t nrChunks)
+	{
+		std::vector<Chunk> chunks{};
+		chunks.reserve(nrChunks);
+
+		const size_t size = static_cast<size_t>(pEnd - pBegin);
+		const char* pChunkBegin = pBegin;
+		for (size_t i{ 1 }; i <= nrChunks && pChunkBegin < pEnd; ++i)
+		{
+			const char* pChunkEnd = pBegin + size * i / nrChunks;
+			if (pChunkEnd < pChunkBegin)
+				pChunkEnd = pChunkBegin;
+			if (pChunkEnd < pEnd)
+				pChunkEnd = std::min(FindLineEnd(pChunkEnd, pEnd) + 1, pEnd);
+
+			Chunk& chunk = chunks.emplace_back();
+			chunk.pBegin = pChunkBegin;
+			chunk.pEnd = pChunkEnd;
+
+			pChunkBegin = pChunkEnd;
+		}
+
+		return chunks;
+	}
+}
+
+bool ObjParser::Parse(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices, bool allowParallel)
+{
+	const MappedFile file{ filename };
+	if (!file.IsOpen())
+		return false;
+
+	return ParseBuffer(file.GetData(), file.GetData() + file.GetSize(), positions, normals, indices, allowParallel);
+}
+
+bool ObjParser::ParseBuffer(const char* pBegin, const char* pEnd, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices, bool allowParallel)
+{
+	positions.clear();
+	normals.clear();
+	indices.clear();
+
+	const size_t size = static_cast<size_t>(pEnd - pBegin);
+	size_t nrChunks{ 1 };
+	if (allowParallel)
+	{
+		//A few chunks per core so an unlucky split (e.g. all faces in the last part) doesn't leave cores idle
+		const size_t maxNrChunks = std::max(std::thread::hardware_concurrency(), 1u) * size_t{ 4 };
+		nrChunks = std::clamp(size / g_MinChunkSize, size_t{ 1 }, maxNrChunks);
+	}
+
+	std::vector<Chunk> chunks = SplitChunks(pBegin, pEnd, nrChunks);
+	if (chunks.size() == 1)
+	{
+		//Parse straight into the output
+		Chunk& chunk = chunks.front();
+		ParseChunk(chunk);
+		if (!chunk.isValid)
+			return false;
+
+		positions = std::move(chunk.positions);
+		indices = std::move(chunk.indices);
+	}
+	else
+	{
+		concurrency::parallel_for(size_t{ 0 }, chunks.size(), [&](size_t i)
+			{
+				ParseChunk(chunks[i]);
+			});
+
+		//Prefix sums give every chunk its place in the output
+		size_t nrPositions{}, nrIndices{};
+		for (Chunk& chunk : chunks)
+		{
+			if (!chunk.isValid)
+				return false;
+
+			chunk.positionOffset = nrPositions;
+			chunk.indexOffset = nrIndices;
+			nrPositions += chunk.positions.size();
+			nrIndices += chunk.indices.size();
+		}
+
+		positions.resize(nrPositions);
+		indices.resize(nrIndices);
+
+		concurrency::parallel_for(size_t{ 0 }, chunks.size(), [&](size_t i)
+			{
+				Chunk& chunk = chunks[i];
+				for (const size_t slot : chunk.relativeIndexSlots)
+				{
+					chunk.indices[slot] += static_cast<int>(chunk.positionOffset);
+				}
+
+				std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionOffset);
+				std::copy(chunk.indices.begin(), chunk.indices.end(), indices.begin() + chunk.indexOffset);
+
+				//Release the chunk's memory as soon as it's stitched
+				chunk.positions = {};
+				chunk.indices = {};
+			});
+	}
+
+	//Forward references are allowed for positive indices, so validation can only happen once everything is read
+	const int nrPositions = static_cast<int>(positions.size());
+	if (std::any_of(indices.begin(), indices.end(), [nrPositions](int index) { return index < 0 || index >= nrPositions; }))
+		return false;
+
+	ComputeNormals(positions, indices, normals);
+	return true;
+}
+
+void ObjParser::ComputeNormals(const std::vector<Vector3>& positions, const std::vector<int>& indices, std::vector<Vector3>& normals)
+{
+	const size_t nrTriangles = indices.size() / 3;
+	normals.resize(nrTriangles);
+
+	const auto computeRange = [&](size_t triangleBegin, size_t triangleEnd)
+		{
+			for (size_t triangle{ triangleBegin }; triangle < triangleEnd; ++triangle)
+			{
+				const size_t index = triangle * 3;
+				const Vector3& v0 = positions[indices[index]];
+				const Vector3 edgeV0V1 = positions[indices[index + 1]] - v0;
+				const Vector3 edgeV0V2 = positions[indices[index + 2]] - v0;
+
+				normals[triangle] = Vector3::Cross(edgeV0V1, edgeV0V2).Normalized();
+			}
+		};
+
+	if (nrTriangles < g_MinParallelNormalsTriangles)
+	{
+		computeRange(0, nrTriangles);
+		return;
+	}
+
+	//Contiguous blocks instead of single triangles, keeps the per task overhead negligible
+	constexpr size_t nrTrianglesPerBlock{ 1 << 14 };
+	const size_t nrBlocks = (nrTriangles + nrTrianglesPerBlock - 1) / nrTrianglesPerBlock;
+	concurrency::parallel_for(size_t{ 0 }, nrBlocks, [&](size_t block)
+		{
+			const size_t triangleBegin = block * nrTrianglesPerBlock;
+			computeRange(triangleBegin, std::min(triangleBegin + nrTrianglesPerBlock, nrTriangles));
+		});
+}
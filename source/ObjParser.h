@@ -0,0 +1,27 @@
+#pragma once
+
+//Standard includes
+#include <string>
+#include <vector>
+
+//Project includes
+#include "Vector3.h"
+
+namespace dae
+{
+	//Wavefront OBJ parsing, only positions and faces are read (texture coordinates, normals, groups, materials... are skipped)
+	namespace ObjParser
+	{
+		//Memory maps the file and parses it, the output vectors are overwritten.
+		//Faces may use the v, v/vt, v//vn and v/vt/vn syntax, negative (relative) indices and more than 3 vertices (fan triangulated).
+		//normals receives one normal per triangle. Returns false if the file can't be read or a face references a missing vertex.
+		//With allowParallel, large files are split into line aligned chunks that are parsed concurrently and stitched afterwards
+		bool Parse(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices, bool allowParallel = true);
+
+		//Same as Parse, for OBJ data that's already in memory
+		bool ParseBuffer(const char* pBegin, const char* pEnd, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices, bool allowParallel = true);
+
+		//One normalized normal per triangle, large meshes are split over multiple threads
+		void ComputeNormals(const std::vector<Vector3>& positions, const std::vector<int>& indices, std::vector<Vector3>& normals);
+	}
+}
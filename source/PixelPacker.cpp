@@ -0,0 +1,111 @@
+//External includes
+#include "SDL.h"
+
+//Project includes
+#include "PixelPacker.h"
+
+//Standard includes
+#include <algorithm>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXEL_PACKER_SSE2
+#endif
+
+using namespace dae;
+
+namespace
+{
+	//The colors are read as one flat float array
+	static_assert(sizeof(ColorRGB) == 3 * sizeof(float));
+
+	inline uint32_t ToChannel(float value)
+	{
+		return static_cast<uint32_t>(std::clamp(value, 0.f, 1.f) * 255.f);
+	}
+
+#if defined(PIXEL_PACKER_SSE2)
+	//_mm_shuffle_ps with the indices in lane order: {a[i0], a[i1], b[i2], b[i3]}
+	template<int i0, int i1, int i2, int i3>
+	inline __m128 Shuffle(__m128 a, __m128 b)
+	{
+		return _mm_shuffle_ps(a, b, _MM_SHUFFLE(i3, i2, i1, i0));
+	}
+#endif
+}
+
+PixelPacker::PixelPacker(const SDL_PixelFormat* pFormat) :
+	m_pFormat(pFormat)
+{
+	if (!pFormat)
+		return;
+
+	m_Layout.redShift = pFormat->Rshift;
+	m_Layout.greenShift = pFormat->Gshift;
+	m_Layout.blueShift = pFormat->Bshift;
+	m_AlphaMask = pFormat->Amask;
+
+	m_IsDirectFormat = pFormat->BytesPerPixel == 4
+		&& pFormat->Rmask == 0xFFu << pFormat->Rshift
+		&& pFormat->Gmask == 0xFFu << pFormat->Gshift
+		&& pFormat->Bmask == 0xFFu << pFormat->Bshift;
+}
+
+void PixelPacker::Pack(const ColorRGB* pColors, uint32_t* pPixels, size_t count) const
+{
+	if (!m_IsDirectFormat)
+	{
+		for (size_t i{ 0 }; i < count; ++i)
+		{
+			pPixels[i] = SDL_MapRGB(m_pFormat,
+				static_cast<uint8_t>(ToChannel(pColors[i].r)),
+				static_cast<uint8_t>(ToChannel(pColors[i].g)),
+				static_cast<uint8_t>(ToChannel(pColors[i].b)));
+		}
+		return;
+	}
+
+	size_t i{ 0 };
+
+#if defined(PIXEL_PACKER_SSE2)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 scale = _mm_set1_ps(255.f);
+	const __m128i redShift = _mm_cvtsi32_si128(static_cast<int>(m_Layout.redShift));
+	const __m128i greenShift = _mm_cvtsi32_si128(static_cast<int>(m_Layout.greenShift));
+	const __m128i blueShift = _mm_cvtsi32_si128(static_cast<int>(m_Layout.blueShift));
+	const __m128i alpha = _mm_set1_epi32(static_cast<int>(m_AlphaMask));
+
+	//4 pixels per iteration: 12 floats r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3, split into one register per channel
+	const float* pFloats = &pColors[0].r;
+	for (; i + 4 <= count; i += 4)
+	{
+		const __m128 a = _mm_loadu_ps(pFloats + i * 3);
+		const __m128 b = _mm_loadu_ps(pFloats + i * 3 + 4);
+		const __m128 c = _mm_loadu_ps(pFloats + i * 3 + 8);
+
+		__m128 red = Shuffle<0, 1, 0, 2>(Shuffle<0, 3, 0, 3>(a, a), Shuffle<2, 2, 1, 1>(b, c));
+		__m128 green = Shuffle<0, 2, 0, 2>(Shuffle<1, 1, 0, 3>(a, b), Shuffle<3, 3, 2, 2>(b, c));
+		__m128 blue = Shuffle<0, 2, 0, 2>(Shuffle<2, 2, 1, 1>(a, b), Shuffle<0, 0, 3, 3>(c, c));
+
+		red = _mm_mul_ps(_mm_min_ps(_mm_max_ps(red, zero), one), scale);
+		green = _mm_mul_ps(_mm_min_ps(_mm_max_ps(green, zero), one), scale);
+		blue = _mm_mul_ps(_mm_min_ps(_mm_max_ps(blue, zero), one), scale);
+
+		__m128i packed = _mm_sll_epi32(_mm_cvttps_epi32(red), redShift);
+		packed = _mm_or_si128(packed, _mm_sll_epi32(_mm_cvttps_epi32(green), greenShift));
+		packed = _mm_or_si128(packed, _mm_sll_epi32(_mm_cvttps_epi32(blue), blueShift));
+		packed = _mm_or_si128(packed, alpha);
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pPixels + i), packed);
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		pPixels[i] = (ToChannel(pColors[i].r) << m_Layout.redShift)
+			| (ToChannel(pColors[i].g) << m_Layout.greenShift)
+			| (ToChannel(pColors[i].b) << m_Layout.blueShift)
+			| m_AlphaMask;
+	}
+}
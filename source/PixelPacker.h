@@ -0,0 +1,36 @@
+#pragma once
+
+//Standard includes
+#include <cstddef>
+#include <cstdint>
+
+//Project includes
+#include "ColorRGB.h"
+#include "FrameQueue.h"
+
+struct SDL_PixelFormat;
+
+namespace dae
+{
+	//Resolves float colors into packed pixels of an SDL surface. The channel shifts are read from the format once,
+	//so packing is a few SIMD instructions per 4 pixels instead of an SDL_MapRGB call per pixel
+	class PixelPacker final
+	{
+	public:
+		PixelPacker() = default;
+		explicit PixelPacker(const SDL_PixelFormat* pFormat);
+
+		//Clamps every channel to [0, 1], scales to 8 bit (truncating, like a static_cast) and packs count colors
+		void Pack(const ColorRGB* pColors, uint32_t* pPixels, size_t count) const;
+
+		const PixelLayout& GetLayout() const { return m_Layout; }
+
+	private:
+		const SDL_PixelFormat* m_pFormat{};
+		PixelLayout m_Layout{};
+		uint32_t m_AlphaMask{};
+
+		//True for 32 bit formats with 8 bits per color channel, anything else goes through SDL_MapRGB
+		bool m_IsDirectFormat{ false };
+	};
+}
@@ -0,0 +1,52 @@
+//External includes
+#include "SDL.h"
+#include "SDL_surface.h"
+
+//Project includes
+#include "Presenter.h"
+
+using namespace dae;
+
+Presenter::Presenter(SDL_Window* pWindow) :
+	m_pWindow(pWindow),
+	m_pWindowSurface(SDL_GetWindowSurface(pWindow))
+{
+	//Same format as the window, so presenting is a plain copy
+	for (SDL_Surface*& pBuffer : m_pBuffers)
+	{
+		pBuffer = SDL_CreateRGBSurfaceWithFormat(0, m_pWindowSurface->w, m_pWindowSurface->h, 32, m_pWindowSurface->format->format);
+	}
+
+	//Buffer 0 is the back buffer, 1 sits in the mailbox and 2 is the front buffer
+}
+
+Presenter::~Presenter()
+{
+	for (SDL_Surface* pBuffer : m_pBuffers)
+	{
+		SDL_FreeSurface(pBuffer);
+	}
+}
+
+void Presenter::Publish()
+{
+	//Whatever is in the mailbox now (a shown frame or one that never got shown) becomes the new back buffer
+	const uint32_t previous = m_Mailbox.exchange(m_BackIndex | m_NewFrameFlag, std::memory_order_acq_rel);
+
+	m_LastFrameIndex = m_BackIndex;
+	m_BackIndex = previous & m_IndexMask;
+}
+
+bool Presenter::Present()
+{
+	if (!(m_Mailbox.load(std::memory_order_acquire) & m_NewFrameFlag))
+		return false;
+
+	//Take the new frame and leave the previous front buffer for the renderer
+	m_FrontIndex = m_Mailbox.exchange(m_FrontIndex, std::memory_order_acq_rel) & m_IndexMask;
+
+	SDL_BlitSurface(m_pBuffers[m_FrontIndex], nullptr, m_pWindowSurface, nullptr);
+	SDL_UpdateWindowSurface(m_pWindow);
+	++m_NrPresentedFrames;
+	return true;
+}
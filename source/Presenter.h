@@ -0,0 +1,61 @@
+#pragma once
+
+//Standard includes
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+struct SDL_Window;
+struct SDL_Surface;
+
+namespace dae
+{
+	//Shows finished frames on a window. The renderer draws into the back buffer, the window shows the front buffer,
+	//and finished frames are handed over through a third mailbox slot with atomic exchanges: neither side ever waits for the other.
+	//SDL's window functions aren't thread safe, so Present has to be called from the thread that created the window.
+	//When frames finish faster than they can be shown, the older unshown ones are skipped
+	class Presenter final
+	{
+	public:
+		explicit Presenter(SDL_Window* pWindow);
+		~Presenter();
+
+		Presenter(const Presenter&) = delete;
+		Presenter(Presenter&&) noexcept = delete;
+		Presenter& operator=(const Presenter&) = delete;
+		Presenter& operator=(Presenter&&) noexcept = delete;
+
+		//Surface to draw the next frame into, same size and format as the window surface
+		SDL_Surface* GetBackBuffer() const { return m_pBuffers[m_BackIndex]; }
+		//The frame passed to the last Publish call, it isn't written to until the next Publish
+		SDL_Surface* GetLastFrame() const { return m_pBuffers[m_LastFrameIndex]; }
+
+		//Hands the back buffer over for presenting and continues with a free one, never blocks
+		void Publish();
+		//Copies the newest published frame to the window if it wasn't shown yet, returns false if there was none.
+		//Never waits for a frame, only SDL_UpdateWindowSurface itself may wait on the display
+		bool Present();
+
+		uint64_t GetNrPresentedFrames() const { return m_NrPresentedFrames; }
+
+	private:
+		SDL_Window* m_pWindow{};
+		SDL_Surface* m_pWindowSurface{};
+
+		static constexpr uint32_t m_NrBuffers{ 3 };
+		std::array<SDL_Surface*, m_NrBuffers> m_pBuffers{};
+
+		//Only touched by the rendering side
+		uint32_t m_BackIndex{ 0 };
+		uint32_t m_LastFrameIndex{ 0 };
+
+		//Only touched by the presenting side
+		uint32_t m_FrontIndex{ 2 };
+		uint64_t m_NrPresentedFrames{ 0 };
+
+		//Buffer index in the mailbox, plus a flag telling whether it holds a frame that wasn't shown yet
+		static constexpr uint32_t m_IndexMask{ 0x3 };
+		static constexpr uint32_t m_NewFrameFlag{ 0x4 };
+		std::atomic<uint32_t> m_Mailbox{ 1 };
+	};
+}
@@ -9,143 +9,1481 @@
 #include "Material.h"
 #include "Scene.h"
 #include "Utils.h"
-#include <future> //async
-#include <ppl.h> //parallel_for
+#include "Topology.h"
+#include "ImageWriter.h"
+#include "Presenter.h"
+
+//Standard includes
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <thread>
 
 using namespace dae;
 
-//#define ASYNC
-#define PARALLEL_FOR
+#define LIGHTING_MODE_CYCLING
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define RENDERER_SSE2
+#endif
+
+namespace
+{
+	//Progressive rendering traces one pixel of every 4x4 block per phase
+	constexpr uint32_t g_ProgressivePatternSize{ 4 };
+	constexpr uint32_t g_NrProgressivePhases{ g_ProgressivePatternSize * g_ProgressivePatternSize };
+
+	//{x, y} offset inside the block for every phase, ordered coarse to fine (4x4 grid > 2x2 grid > every pixel)
+	constexpr uint8_t g_ProgressiveOffsets[g_NrProgressivePhases][2]
+	{
+		{0,0}, {2,2}, {2,0}, {0,2},
+		{1,1}, {3,3}, {3,1}, {1,3},
+		{1,0}, {3,2}, {3,0}, {1,2},
+		{0,1}, {2,3}, {2,1}, {0,3}
+	};
+
+	//Inverse of the table above, [y][x] > phase
+	constexpr auto g_ProgressivePhaseOfOffset = []
+		{
+			std::array<std::array<uint32_t, g_ProgressivePatternSize>, g_ProgressivePatternSize> phases{};
+			for (uint32_t phase{ 0 }; phase < g_NrProgressivePhases; ++phase)
+			{
+				phases[g_ProgressiveOffsets[phase][1]][g_ProgressiveOffsets[phase][0]] = phase;
+			}
+			return phases;
+		}();
+
+	//Checkerboard rendering needs two frames to trace every pixel
+	constexpr uint32_t g_NrCheckerboardPhases{ 2 };
+	//Steps of the search for the previous frame's pixel that moved onto the current one
+	constexpr uint32_t g_NrReprojectionIterations{ 3 };
+	//How close (in pixels) that pixel has to land, and how much farther away than its traced neighbours it may be before it counts as hidden
+	constexpr float g_ReprojectionTolerance{ 0.75f };
+	constexpr float g_ReprojectionDepthTolerance{ 1.05f };
+
+	//Adaptive sampling traces the corners of 4x4 blocks first
+	constexpr uint32_t g_AdaptiveBlockSize{ 4 };
+	//Corners with normals further apart than this (cosine) or colors differing more than this fraction (of the brighter one,
+	//but at least the floor) have something between them worth tracing
+	constexpr float g_AdaptiveNormalThreshold{ 0.98f };
+	constexpr float g_AdaptiveColorThreshold{ 0.1f };
+	constexpr float g_AdaptiveColorFloor{ 0.02f };
+
+	//A fixed render scale below this would upscale more than the filter can reconstruct
+	constexpr float g_MinFixedRenderScale{ 0.25f };
+	//Source pixels are on the same surface if they hit the same object, with normals at most this far apart (cosine)
+	//and at most this fraction of the depth away from each other's tangent plane
+	constexpr float g_UpscaleNormalThreshold{ 0.9f };
+	constexpr float g_UpscaleDepthTolerance{ 0.05f };
+
+	//Dirty regions ignore geometry closer to the camera than this, everything nearer projects far off screen anyway
+	constexpr float g_DirtyRegionNearDepth{ 0.01f };
+
+	//Convex hull of the points, extended by every non-negative combination of the directions
+	struct ConvexRegion
+	{
+		std::vector<Vector3> points{};
+		std::vector<Vector3> directions{};
+	};
+
+	//Part of the region on the side of the plane the normal points to. The result can hold more points than the hull needs:
+	//every segment between two points and every ray lies inside the region, so their crossings with the plane do too,
+	//and the real corners of the clipped region are among them
+	ConvexRegion ClipRegion(const ConvexRegion& region, const Vector3& planeOrigin, const Vector3& planeNormal)
+	{
+		ConvexRegion clipped{};
+
+		std::vector<float> distances(region.points.size());
+		for (size_t i{ 0 }; i < region.points.size(); ++i)
+		{
+			distances[i] = Vector3::Dot(region.points[i] - planeOrigin, planeNormal);
+			if (distances[i] >= 0.f)
+				clipped.points.push_back(region.points[i]);
+		}
+
+		for (size_t i{ 0 }; i < region.points.size(); ++i)
+		{
+			for (size_t j{ i + 1 }; j < region.points.size(); ++j)
+			{
+				if ((distances[i] < 0.f) != (distances[j] < 0.f))
+					clipped.points.push_back(region.points[i] + (region.points[j] - region.points[i]) * (distances[i] / (distances[i] - distances[j])));
+			}
+		}
+
+		std::vector<float> approaches(region.directions.size());
+		for (size_t i{ 0 }; i < region.directions.size(); ++i)
+		{
+			approaches[i] = Vector3::Dot(region.directions[i], planeNormal);
+			if (approaches[i] >= 0.f)
+				clipped.directions.push_back(region.directions[i]);
+
+			for (size_t j{ 0 }; j < region.points.size(); ++j)
+			{
+				if ((distances[j] < 0.f && approaches[i] > 0.f) || (distances[j] > 0.f && approaches[i] < 0.f))
+					clipped.points.push_back(region.points[j] - region.directions[i] * (distances[j] / approaches[i]));
+			}
+		}
+
+		//Combinations of a direction leaving the plane and one entering it can run along the plane forever
+		for (size_t i{ 0 }; i < region.directions.size(); ++i)
+		{
+			for (size_t j{ 0 }; j < region.directions.size(); ++j)
+			{
+				if (approaches[i] < 0.f && approaches[j] > 0.f)
+					clipped.directions.push_back(region.directions[i] * approaches[j] - region.directions[j] * approaches[i]);
+			}
+		}
+
+		return clipped;
+	}
+
+	//Rectangle in render pixels
+	struct ScreenRect
+	{
+		float minX{ FLT_MAX };
+		float minY{ FLT_MAX };
+		float maxX{ -FLT_MAX };
+		float maxY{ -FLT_MAX };
+
+		static ScreenRect Unbounded() { return { -FLT_MAX, -FLT_MAX, FLT_MAX, FLT_MAX }; }
+		bool IsUnbounded() const { return minX == -FLT_MAX || minY == -FLT_MAX || maxX == FLT_MAX || maxY == FLT_MAX; }
+		bool IsEmpty() const { return minX > maxX || minY > maxY; }
+
+		void Add(float x, float y)
+		{
+			minX = std::min(minX, x);
+			minY = std::min(minY, y);
+			maxX = std::max(maxX, x);
+			maxY = std::max(maxY, y);
+		}
+		ScreenRect Intersect(const ScreenRect& other) const
+		{
+			return { std::max(minX, other.minX), std::max(minY, other.minY), std::min(maxX, other.maxX), std::min(maxY, other.maxY) };
+		}
+		ScreenRect Union(const ScreenRect& other) const
+		{
+			return { std::min(minX, other.minX), std::min(minY, other.minY), std::max(maxX, other.maxX), std::max(maxY, other.maxY) };
+		}
+	};
+
+	//Screen bounds of a region in front of the camera (clipped to the near depth), inverse of the pixel mapping in RenderPixel.
+	//A direction ends up at its vanishing point. False if the region runs off sideways without getting any further away
+	bool ProjectRegion(const ConvexRegion& region, const Camera& camera, float multiply, float xAddition, float yAddition, ScreenRect& bounds)
+	{
+		const auto project = [&](const Vector3& direction)
+			{
+				const float depth = Vector3::Dot(direction, camera.forward);
+				if (depth < FLT_EPSILON)
+					return false;
+
+				bounds.Add(Vector3::Dot(direction, camera.right) / depth / multiply - xAddition,
+					yAddition - Vector3::Dot(direction, camera.up) / depth / multiply);
+				return true;
+			};
+
+		bounds = {};
+		for (const Vector3& point : region.points)
+		{
+			project(point - camera.origin);
+		}
+		for (const Vector3& direction : region.directions)
+		{
+			if (!project(direction))
+				return false;
+		}
+		return true;
+	}
+
+	//Radical inverse of index in the given base, low discrepancy sequence in [0, 1)
+	inline float Halton(uint32_t index, uint32_t base)
+	{
+		float result{ 0.f };
+		float fraction{ 1.f / base };
+		while (index > 0)
+		{
+			result += (index % base) * fraction;
+			index /= base;
+			fraction /= base;
+		}
+		return result;
+	}
+
+	//Interpolates every byte of two packed 8888 pixels separately (weight 0 > a, 256 > b),
+	//this works for any 32 bit surface format with 8 bits per channel
+	inline uint32_t LerpPacked(uint32_t a, uint32_t b, uint32_t weight)
+	{
+		const uint32_t inverseWeight = 256 - weight;
+		const uint32_t evenBytes = (((a & 0x00FF00FF) * inverseWeight + (b & 0x00FF00FF) * weight) >> 8) & 0x00FF00FF;
+		const uint32_t oddBytes = ((((a >> 8) & 0x00FF00FF) * inverseWeight + ((b >> 8) & 0x00FF00FF) * weight) >> 8) & 0x00FF00FF;
+		return evenBytes | (oddBytes << 8);
+	}
+
+	//Blends four packed 8888 pixels with weights that add up to 256, every byte separately
+	inline uint32_t BlendPacked(const uint32_t(&pixels)[4], const uint32_t(&weights)[4])
+	{
+#if defined(RENDERER_SSE2)
+		//Two pixels per register with every byte widened to 16 bits, 255 * 256 still fits
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i pixels01 = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, static_cast<int>(pixels[1]), static_cast<int>(pixels[0])), zero);
+		const __m128i pixels23 = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, static_cast<int>(pixels[3]), static_cast<int>(pixels[2])), zero);
+		const __m128i weights01 = _mm_unpacklo_epi64(_mm_set1_epi16(static_cast<short>(weights[0])), _mm_set1_epi16(static_cast<short>(weights[1])));
+		const __m128i weights23 = _mm_unpacklo_epi64(_mm_set1_epi16(static_cast<short>(weights[2])), _mm_set1_epi16(static_cast<short>(weights[3])));
+
+		__m128i sum = _mm_add_epi16(_mm_mullo_epi16(pixels01, weights01), _mm_mullo_epi16(pixels23, weights23));
+		sum = _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+		sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(128)), 8);
+		return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_packus_epi16(sum, sum)));
+#else
+		uint32_t result{ 0 };
+		for (uint32_t shift{ 0 }; shift < 32; shift += 8)
+		{
+			uint32_t sum{ 128 };
+			for (uint32_t i{ 0 }; i < 4; ++i)
+			{
+				sum += ((pixels[i] >> shift) & 0xFF) * weights[i];
+			}
+			result |= (sum >> 8) << shift;
+		}
+		return result;
+#endif
+	}
+
+	//FNV-1a over the light fields, a moved or recolored light changes the shading of the whole frame
+	uint64_t HashLights(const std::vector<Light>& lights)
+	{
+		uint64_t hash{ Utils::HASH_BASIS };
+		for (const Light& light : lights)
+		{
+			hash = Utils::HashBytes(hash, &light.origin, sizeof(light.origin));
+			hash = Utils::HashBytes(hash, &light.direction, sizeof(light.direction));
+			hash = Utils::HashBytes(hash, &light.color, sizeof(light.color));
+			hash = Utils::HashBytes(hash, &light.intensity, sizeof(light.intensity));
+			hash = Utils::HashBytes(hash, &light.type, sizeof(light.type));
+		}
+		return hash;
+	}
+}
+
+
+Renderer::Renderer(SDL_Window * pWindow) :
+	m_pWindow(pWindow),
+	m_pPresenter(std::make_unique<Presenter>(pWindow))
+{
+	//Initialize, frames are traced into the presenter's back buffer
+	m_pBuffer = m_pPresenter->GetBackBuffer();
+	m_Width = m_pBuffer->w;
+	m_Height = m_pBuffer->h;
+	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+	m_PixelPacker = PixelPacker{ m_pBuffer->format };
+
+	//Start at full resolution
+	SetRenderScale(1.f);
+}
+
+Renderer::Renderer(int width, int height) :
+	m_pBuffer(SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_ARGB8888)),
+	m_OwnsBuffer(true),
+	m_Width(width),
+	m_Height(height)
+{
+	//Initialize
+	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+	m_PixelPacker = PixelPacker{ m_pBuffer->format };
+
+	//Start at full resolution
+	SetRenderScale(1.f);
+}
+
+Renderer::Renderer()
+{
+}
+
+Renderer::~Renderer()
+{
+	CancelFrame();
+
+	if (m_OwnsBuffer)
+		SDL_FreeSurface(m_pBuffer);
+}
+
+void Renderer::Render(Scene* pScene)
+{
+	if (!RenderFrame(pScene, pScene->GetCamera()))
+		return;
+
+	//@END
+	//Hand the frame over, UpdateWindow shows it
+	Present();
+}
+
+void Renderer::UpdateWindow()
+{
+	if (m_pPresenter)
+		m_pPresenter->Present();
+}
+
+void Renderer::BeginFrame(Scene* pScene)
+{
+	CancelFrame();
+	m_IsFrameRestart = m_WasFrameCanceled;
+	m_WasFrameCanceled = false;
+
+	//The camera is copied, so it can keep receiving input while this frame is being traced
+	m_CancelRequested.store(false);
+	m_InFlightViewState = GetViewState(pScene, pScene->GetCamera());
+	m_FrameFuture = std::async(std::launch::async, [this, pScene, camera = pScene->GetCamera()]
+		{
+			return RenderFrame(pScene, camera);
+		});
+}
+
+bool Renderer::PresentFinishedFrame(uint32_t timeoutMs)
+{
+	if (!m_FrameFuture.valid())
+		return false;
+
+	if (m_FrameFuture.wait_for(std::chrono::milliseconds(timeoutMs)) != std::future_status::ready)
+		return false;
+
+	//Canceled frames are never shown
+	if (!m_FrameFuture.get())
+		return false;
+
+	Present();
+	return true;
+}
+
+void Renderer::Present()
+{
+	if (!m_pPresenter)
+		return;
+
+	//Continue in a free buffer, the next frame overwrites every pixel of it anyway
+	m_pPresenter->Publish();
+	m_pBuffer = m_pPresenter->GetBackBuffer();
+	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+
+	if (m_RenderWidth == m_Width && m_RenderHeight == m_Height)
+		m_pRenderPixels = m_pBufferPixels;
+}
+
+const SDL_Surface* Renderer::GetFinishedFrame() const
+{
+	//After Present the back buffer is a stale frame, the last finished one is left untouched until the next Present
+	return m_pPresenter ? m_pPresenter->GetLastFrame() : m_pBuffer;
+}
+
+void Renderer::CancelFrame()
+{
+	if (!m_FrameFuture.valid())
+		return;
+
+	//Workers check the token before every tile, so this returns within one tile's worth of work
+	m_CancelRequested.store(true);
+	m_FrameFuture.wait();
+	m_FrameFuture = {};
+	m_CancelRequested.store(false);
+	m_WasFrameCanceled = true;
+}
+
+bool Renderer::CancelStaleFrame(Scene* pScene)
+{
+	if (!IsFrameInFlight() || m_IsFrameRestart)
+		return false;
+
+	if (GetViewState(pScene, pScene->GetCamera()).IsEqual(m_InFlightViewState))
+		return false;
+
+	CancelFrame();
+	return true;
+}
+
+bool Renderer::RenderFrame(Scene* pScene, const Camera& camera)
+{
+	//Refresh (or release) the per node copies of the scene geometry
+	pScene->UpdateNodeReplicas(m_NumaReplicationEnabled ? Topology::GetNrNodes() : 0);
+
+	const ViewState viewState = GetViewState(pScene, camera);
+
+	const bool isViewStatic = viewState.IsEqual(m_LastViewState);
+
+	//Only a complete frame can be the first sample or have its unchanged tiles reused, a progressive render has to converge first
+	//and a checkerboard render needs both halves traced for the same view
+	const bool isFrameComplete = m_CheckerboardEnabled ? m_NrCheckerboardFrames >= g_NrCheckerboardPhases
+		: !m_ProgressiveEnabled || m_NrProgressivePhases >= g_NrProgressivePhases;
+	const bool canReuseFrame = m_DirtyRegionsEnabled && !isViewStatic && isFrameComplete && viewState.IsEqualExceptGeometry(m_LastViewState);
+	//Only the lighting changed, the surfaces every pixel sees are still in the G-buffer
+	const bool canReshade = m_GBufferEnabled && !isViewStatic && isFrameComplete && viewState.HasSameSurfaces(m_LastViewState);
+
+	if (UsesGBuffer() && m_GBuffer.size() != m_HdrPixels.size())
+		m_GBuffer.assign(m_HdrPixels.size(), {});
+
+	const uint32_t nrTiles = ((m_RenderWidth + m_TileSize - 1) / m_TileSize) * ((m_RenderHeight + m_TileSize - 1) / m_TileSize);
+	m_NrRetracedTiles = nrTiles;
+
+	if (m_AccumulationEnabled && isViewStatic && isFrameComplete)
+	{
+		AccumulateFrame(pScene, camera);
+	}
+	else if (canReshade)
+	{
+		m_NrRetracedTiles = 0;
+		ShadePass(pScene);
+	}
+	else if (canReuseFrame && FindDirtyTiles(pScene, camera))
+	{
+		//The unchanged tiles keep the anti-aliased average if there is one
+		if (m_NrAccumulatedFrames > 1)
+			m_HdrPixels = m_AccumulatedPixels;
+
+		m_NrRetracedTiles = static_cast<uint32_t>(std::count(m_DirtyTiles.begin(), m_DirtyTiles.end(), uint8_t{ 1 }));
+		m_TraceDirtyTilesOnly = true;
+		TracePass(pScene, camera, 0, 0, 1);
+		m_TraceDirtyTilesOnly = false;
+
+		//The checkerboard history doesn't know where the moved objects are now
+		m_HasCheckerboardHistory = false;
+	}
+	else if (m_CheckerboardEnabled)
+	{
+		RenderCheckerboard(pScene, camera, viewState);
+	}
+	else if (m_AdaptiveSamplingEnabled)
+	{
+		RenderAdaptive(pScene, camera, viewState);
+	}
+	else if (m_ProgressiveEnabled)
+	{
+		RenderProgressive(pScene, camera, viewState);
+	}
+	else
+	{
+		TracePass(pScene, camera, 0, 0, 1);
+	}
+
+	//Anything changed? The accumulated samples belong to another image
+	if (!isViewStatic)
+		m_NrAccumulatedFrames = 0;
+
+	//Tone map the HDR buffer into the render target, this runs every frame so exposure changes don't need a retrace
+	Resolve();
+
+	//Reduced resolution, stretch the result over the window
+	if (m_pRenderPixels != m_pBufferPixels)
+	{
+		if (m_EdgeAwareUpscalingEnabled)
+			UpscaleEdgeAware();
+		else
+			Upscale();
+	}
+
+	//Partially traced, nothing in the buffer can be trusted anymore
+	if (m_CancelRequested.load())
+	{
+		m_LastViewState = {};
+		m_NrProgressivePhases = 0;
+		m_NrAccumulatedFrames = 0;
+		m_HasCheckerboardHistory = false;
+		return false;
+	}
+
+	m_LastViewState = viewState;
+	StoreSceneState(pScene);
+	return true;
+}
+
+void Renderer::RenderProgressive(Scene* pScene, const Camera& camera, const ViewState& viewState)
+{
+	//Anything changed? Start over from the coarsest pattern
+	if (!viewState.IsEqual(m_LastViewState))
+		m_NrProgressivePhases = 0;
+
+	//Converged, the buffer still holds the full image
+	if (m_NrProgressivePhases >= g_NrProgressivePhases)
+		return;
+
+	//Trace phases until the next one would exceed the budget (estimated by the duration of the previous one)
+	//At least one phase is traced every frame, so a frame never costs more than 1/16th of a full render
+	const auto frameStart = std::chrono::high_resolution_clock::now();
+	float lastPhaseTime{ 0.f };
+	bool isFirstPhase{ true };
+
+	while (m_NrProgressivePhases < g_NrProgressivePhases && !m_CancelRequested.load(std::memory_order_relaxed))
+	{
+		const auto phaseStart = std::chrono::high_resolution_clock::now();
+		const float elapsed = std::chrono::duration<float>(phaseStart - frameStart).count();
+		if (!isFirstPhase && elapsed + lastPhaseTime > m_ProgressiveBudget)
+			break;
+
+		const uint8_t* pOffset = g_ProgressiveOffsets[m_NrProgressivePhases];
+		TracePass(pScene, camera, pOffset[0], pOffset[1], g_ProgressivePatternSize);
+		++m_NrProgressivePhases;
+
+		lastPhaseTime = std::chrono::duration<float>(std::chrono::high_resolution_clock::now() - phaseStart).count();
+		isFirstPhase = false;
+	}
+
+	if (m_NrProgressivePhases < g_NrProgressivePhases)
+		FillProgressiveGaps();
+}
+
+void Renderer::RenderCheckerboard(Scene* pScene, const Camera& camera, const ViewState& viewState)
+{
+	//Anything changed? Both halves have to be traced again
+	const bool isViewStatic = viewState.IsEqual(m_LastViewState);
+	if (!isViewStatic)
+		m_NrCheckerboardFrames = 0;
+
+	//Both halves were traced for this view, the buffer still holds the full image
+	if (m_NrCheckerboardFrames >= g_NrCheckerboardPhases)
+		return;
+
+	if (m_HistoryPixels.size() != m_HdrPixels.size())
+	{
+		m_HistoryPixels.assign(m_HdrPixels.size(), {});
+		m_HistorySamples.assign(m_HdrPixels.size(), {});
+		m_CheckerboardSamples.assign(m_HdrPixels.size(), {});
+		m_HasCheckerboardHistory = false;
+	}
+
+	if (!m_HasCheckerboardHistory)
+	{
+		//Nothing to reproject from, start with a full frame
+		TracePass(pScene, camera, 0, 0, 1);
+		ReconstructCheckerboard(camera, true, false);
+		m_NrCheckerboardFrames = g_NrCheckerboardPhases;
+	}
+	else
+	{
+		//The last frame becomes the history, every pixel of the new one gets traced or reconstructed
+		std::swap(m_HdrPixels, m_HistoryPixels);
+		m_CheckerboardParity ^= 1;
+
+		//Even rows start at the parity, odd rows at the other column
+		TracePass(pScene, camera, m_CheckerboardParity, 0, 2);
+		TracePass(pScene, camera, 1 - m_CheckerboardParity, 1, 2);
+		ReconstructCheckerboard(camera, false, isViewStatic);
+		++m_NrCheckerboardFrames;
+	}
+
+	std::swap(m_HistorySamples, m_CheckerboardSamples);
+	m_HasCheckerboardHistory = true;
+}
+
+void Renderer::ReconstructCheckerboard(const Camera& camera, bool isFullFrame, bool isViewStatic)
+{
+	//Same transform as Camera::cameraToWorld, built from the vectors the view rays were traced with
+	const Matrix worldToCamera = Matrix::Inverse(Matrix{ camera.right, camera.up, camera.forward, camera.origin });
+	const float multiply{ 2.f * camera.fov / (float)m_RenderHeight };
+
+	//Inverse of the pixel mapping in RenderPixel (both mappings are the same), pixel centers land on whole coordinates
+	const auto project = [&](const Vector3& position, float& x, float& y, float& depth)
+		{
+			const Vector3 cameraPosition = worldToCamera.TransformPoint(position);
+			if (cameraPosition.z < g_DirtyRegionNearDepth)
+				return false;
+
+			x = cameraPosition.x / (cameraPosition.z * multiply) - m_XAddition;
+			y = m_YAddition - cameraPosition.y / (cameraPosition.z * multiply);
+			depth = cameraPosition.z;
+			return true;
+		};
+
+	const int width = m_RenderWidth;
+	const int height = m_RenderHeight;
+
+	ForEachTile(static_cast<uint32_t>(m_RenderWidth), static_cast<uint32_t>(m_RenderHeight), [&](const Tile& tile)
+		{
+			for (uint32_t py{ tile.y }; py < tile.endY; ++py)
+			{
+				for (uint32_t px{ tile.x }; px < tile.endX; ++px)
+				{
+					const uint32_t pixelIndex = px + (py * m_RenderWidth);
+					ReprojectionSample& sample = m_CheckerboardSamples[pixelIndex];
+
+					//Traced this frame
+					if (isFullFrame || ((px + py) & 1) == m_CheckerboardParity)
+					{
+						const GBufferSample& hit = m_GBuffer[pixelIndex];
+						sample = { hit.position, hit.didHit };
+						continue;
+					}
+
+					//Nothing moved, the last frame traced exactly this pixel
+					if (isViewStatic)
+					{
+						m_HdrPixels[pixelIndex] = m_HistoryPixels[pixelIndex];
+						sample = m_HistorySamples[pixelIndex];
+						continue;
+					}
+
+					//The four direct neighbours were all traced this frame
+					ColorRGB neighbourSum{};
+					ColorRGB minColor{ FLT_MAX, FLT_MAX, FLT_MAX };
+					ColorRGB maxColor{ -FLT_MAX, -FLT_MAX, -FLT_MAX };
+					float maxDepth{ 0.f };
+					uint32_t neighbourIndices[4]{};
+					float neighbourDepths[4]{};
+					uint32_t nrNeighbours{ 0 };
+					const auto addNeighbour = [&](uint32_t neighbourIndex)
+						{
+							const ColorRGB& color = m_HdrPixels[neighbourIndex];
+							neighbourSum += color;
+							minColor = { std::min(minColor.r, color.r), std::min(minColor.g, color.g), std::min(minColor.b, color.b) };
+							maxColor = { std::max(maxColor.r, color.r), std::max(maxColor.g, color.g), std::max(maxColor.b, color.b) };
+
+							const GBufferSample& hit = m_GBuffer[neighbourIndex];
+							const float depth = hit.didHit ? worldToCamera.TransformPoint(hit.position).z : FLT_MAX;
+							maxDepth = std::max(maxDepth, depth);
+							neighbourIndices[nrNeighbours] = neighbourIndex;
+							neighbourDepths[nrNeighbours] = depth;
+							++nrNeighbours;
+						};
+
+					if (px > 0)
+						addNeighbour(pixelIndex - 1);
+					if (static_cast<int>(px) + 1 < width)
+						addNeighbour(pixelIndex + 1);
+					if (py > 0)
+						addNeighbour(pixelIndex - width);
+					if (static_cast<int>(py) + 1 < height)
+						addNeighbour(pixelIndex + width);
+
+					//Look for the previous frame's pixel whose surface moved onto this one: step back by the motion of the current guess
+					int sourceX = static_cast<int>(px);
+					int sourceY = static_cast<int>(py);
+					bool isReprojected{ false };
+					float reprojectedDepth{ 0.f };
+					for (uint32_t iteration{ 0 }; iteration < g_NrReprojectionIterations; ++iteration)
+					{
+						if (sourceX < 0 || sourceX >= width || sourceY < 0 || sourceY >= height)
+							break;
+
+						const ReprojectionSample& history = m_HistorySamples[sourceX + (sourceY * width)];
+						float x{}, y{}, depth{};
+						if (!history.isValid || !project(history.position, x, y, depth))
+							break;
+
+						if (std::abs(x - px) <= g_ReprojectionTolerance && std::abs(y - py) <= g_ReprojectionTolerance)
+						{
+							//Farther away than everything around it, something in front of it got uncovered
+							isReprojected = depth <= maxDepth * g_ReprojectionDepthTolerance;
+							reprojectedDepth = depth;
+							break;
+						}
+
+						sourceX = static_cast<int>(std::lround(px - (x - sourceX)));
+						sourceY = static_cast<int>(std::lround(py - (y - sourceY)));
+					}
+
+					if (isReprojected)
+					{
+						//Clamped to the neighbourhood, so shading changes and moving objects don't leave trails
+						const uint32_t sourceIndex = sourceX + (sourceY * width);
+						const ColorRGB& history = m_HistoryPixels[sourceIndex];
+						m_HdrPixels[pixelIndex] = { std::clamp(history.r, minColor.r, maxColor.r), std::clamp(history.g, minColor.g, maxColor.g), std::clamp(history.b, minColor.b, maxColor.b) };
+						sample = m_HistorySamples[sourceIndex];
+					}
+					else if (nrNeighbours > 0)
+					{
+						//Disoccluded, interpolate the traced neighbours
+						m_HdrPixels[pixelIndex] = neighbourSum / static_cast<float>(nrNeighbours);
+						sample = {};
+					}
+
+					//The surface description (for the upscaler) comes from the traced neighbour closest in depth to the reprojected surface,
+					//or from the nearest one when there is no reprojected surface
+					uint32_t closestNeighbour{ 0 };
+					for (uint32_t neighbour{ 1 }; neighbour < nrNeighbours; ++neighbour)
+					{
+						if (std::abs(neighbourDepths[neighbour] - reprojectedDepth) < std::abs(neighbourDepths[closestNeighbour] - reprojectedDepth))
+							closestNeighbour = neighbour;
+					}
+					if (nrNeighbours > 0)
+						m_GBuffer[pixelIndex] = m_GBuffer[neighbourIndices[closestNeighbour]];
+				}
+			}
+		});
+}
+
+void Renderer::RenderAdaptive(Scene* pScene, const Camera& camera, const ViewState& viewState)
+{
+	//Nothing changed, the buffer still holds the image
+	if (viewState.IsEqual(m_LastViewState))
+		return;
+
+	//The block corners, every one of them has to be known before any block can be judged
+	TracePass(pScene, camera, 0, 0, g_AdaptiveBlockSize);
+
+	//Local variables
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	//Pixel mapping parameters
+	const float fov = camera.fov;
+	const float aspectRatio = m_RenderWidth / static_cast<float>(m_RenderHeight);
+	const float multiply{ 2.f * camera.fov / (float)m_RenderHeight };
+
+	//Tiles are a multiple of the block size, so every block lies in a single tile
+	ForEachTile(static_cast<uint32_t>(m_RenderWidth), static_cast<uint32_t>(m_RenderHeight), [&](const Tile& tile)
+		{
+			if (m_NumaReplicationEnabled)
+			{
+				Topology::RefreshCurrentNode();
+				pScene->SyncNodeReplica(Topology::GetCurrentNode());
+			}
+
+			for (uint32_t blockY{ tile.y }; blockY < tile.endY; blockY += g_AdaptiveBlockSize)
+			{
+				const uint32_t endY = std::min(blockY + g_AdaptiveBlockSize, tile.endY);
+				for (uint32_t blockX{ tile.x }; blockX < tile.endX; blockX += g_AdaptiveBlockSize)
+				{
+					const uint32_t endX = std::min(blockX + g_AdaptiveBlockSize, tile.endX);
+
+					if (!IsAdaptiveBlockSmooth(blockX, blockY))
+					{
+						for (uint32_t py{ blockY }; py < endY; ++py)
+						{
+							for (uint32_t px{ blockX }; px < endX; ++px)
+							{
+								//Traced already
+								if (px == blockX && py == blockY)
+									continue;
+
+								const uint32_t pixelIndex = px + (py * m_RenderWidth);
+								if (m_UsePPTPixelMapping)
+									m_HdrPixels[pixelIndex] = RenderPixel(pScene, pixelIndex, fov, aspectRatio, camera, lights, materials, &m_GBuffer[pixelIndex]);
+								else
+									m_HdrPixels[pixelIndex] = RenderPixel(pScene, pixelIndex, multiply, camera, lights, materials, &m_GBuffer[pixelIndex]);
+							}
+						}
+						continue;
+					}
+
+					//Bilinear between the corners, the G-buffer gets the interpolated surface so re-shading and reprojection still work
+					const uint32_t cornerIndices[4]
+					{
+						blockX + (blockY * m_RenderWidth), blockX + g_AdaptiveBlockSize + (blockY * m_RenderWidth),
+						blockX + ((blockY + g_AdaptiveBlockSize) * m_RenderWidth), blockX + g_AdaptiveBlockSize + ((blockY + g_AdaptiveBlockSize) * m_RenderWidth)
+					};
+					const ColorRGB& color00 = m_HdrPixels[cornerIndices[0]];
+					const ColorRGB& color10 = m_HdrPixels[cornerIndices[1]];
+					const ColorRGB& color01 = m_HdrPixels[cornerIndices[2]];
+					const ColorRGB& color11 = m_HdrPixels[cornerIndices[3]];
+					const GBufferSample& sample00 = m_GBuffer[cornerIndices[0]];
+					const GBufferSample& sample10 = m_GBuffer[cornerIndices[1]];
+					const GBufferSample& sample01 = m_GBuffer[cornerIndices[2]];
+					const GBufferSample& sample11 = m_GBuffer[cornerIndices[3]];
+
+					for (uint32_t py{ blockY }; py < endY; ++py)
+					{
+						const float v = (py - blockY) / static_cast<float>(g_AdaptiveBlockSize);
+						for (uint32_t px{ blockX }; px < endX; ++px)
+						{
+							if (px == blockX && py == blockY)
+								continue;
+
+							const float u = (px - blockX) / static_cast<float>(g_AdaptiveBlockSize);
+							const float weight00 = (1.f - u) * (1.f - v);
+							const float weight10 = u * (1.f - v);
+							const float weight01 = (1.f - u) * v;
+							const float weight11 = u * v;
+
+							const uint32_t pixelIndex = px + (py * m_RenderWidth);
+							m_HdrPixels[pixelIndex] = color00 * weight00 + color10 * weight10 + color01 * weight01 + color11 * weight11;
+
+							GBufferSample& sample = m_GBuffer[pixelIndex];
+							sample = sample00;
+							sample.position = sample00.position * weight00 + sample10.position * weight10 + sample01.position * weight01 + sample11.position * weight11;
+							sample.depth = sample00.depth * weight00 + sample10.depth * weight10 + sample01.depth * weight01 + sample11.depth * weight11;
+							sample.normal = (sample00.normal * weight00 + sample10.normal * weight10 + sample01.normal * weight01 + sample11.normal * weight11).Normalized();
+							sample.rayDirection = (sample00.rayDirection * weight00 + sample10.rayDirection * weight10 + sample01.rayDirection * weight01 + sample11.rayDirection * weight11).Normalized();
+						}
+					}
+				}
+			}
+		});
+}
+
+bool Renderer::IsAdaptiveBlockSmooth(uint32_t x, uint32_t y) const
+{
+	//The right and bottom edge blocks miss corners, they are always traced
+	if (x + g_AdaptiveBlockSize >= static_cast<uint32_t>(m_RenderWidth) || y + g_AdaptiveBlockSize >= static_cast<uint32_t>(m_RenderHeight))
+		return false;
+
+	const uint32_t cornerIndices[4]
+	{
+		x + (y * m_RenderWidth), x + g_AdaptiveBlockSize + (y * m_RenderWidth),
+		x + ((y + g_AdaptiveBlockSize) * m_RenderWidth), x + g_AdaptiveBlockSize + ((y + g_AdaptiveBlockSize) * m_RenderWidth)
+	};
+
+	const GBufferSample& reference = m_GBuffer[cornerIndices[0]];
+	const ColorRGB& referenceColor = m_HdrPixels[cornerIndices[0]];
+	const auto isColorClose = [](float a, float b)
+		{
+			return std::abs(a - b) <= g_AdaptiveColorThreshold * std::max({ a, b, g_AdaptiveColorFloor });
+		};
+
+	for (uint32_t corner{ 1 }; corner < 4; ++corner)
+	{
+		const GBufferSample& sample = m_GBuffer[cornerIndices[corner]];
+		const ColorRGB& color = m_HdrPixels[cornerIndices[corner]];
+
+		if (sample.didHit != reference.didHit)
+			return false;
+
+		if (sample.didHit && (sample.objectIndex != reference.objectIndex || sample.normal * reference.normal < g_AdaptiveNormalThreshold))
+			return false;
+
+		if (!isColorClose(color.r, referenceColor.r) || !isColorClose(color.g, referenceColor.g) || !isColorClose(color.b, referenceColor.b))
+			return false;
+	}
+
+	return true;
+}
+
+void Renderer::TracePass(Scene* pScene, const Camera& camera, uint32_t offsetX, uint32_t offsetY, uint32_t step)
+{
+	//Local variables
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	//Pixel mapping parameters
+	const float fov = camera.fov;
+	const float aspectRatio = m_RenderWidth / static_cast<float>(m_RenderHeight);
+	const float multiply{ 2.f * camera.fov / (float)m_RenderHeight };
+
+	//Jittered rays don't hit the pixel centers the G-buffer describes
+	GBufferSample* const pGBuffer = UsesGBuffer() && m_JitterX == 0.f && m_JitterY == 0.f ? m_GBuffer.data() : nullptr;
+
+	ForEachTile(static_cast<uint32_t>(m_RenderWidth), static_cast<uint32_t>(m_RenderHeight), [&](const Tile& tile)
+		{
+			if (m_NumaReplicationEnabled)
+			{
+				Topology::RefreshCurrentNode();
+				pScene->SyncNodeReplica(Topology::GetCurrentNode());
+			}
+
+			//Unchanged since the last frame
+			if (m_TraceDirtyTilesOnly)
+			{
+				const uint32_t nrTilesX = (m_RenderWidth + m_TileSize - 1) / m_TileSize;
+				if (!m_DirtyTiles[(tile.y / m_TileSize) * nrTilesX + tile.x / m_TileSize])
+					return;
+			}
+
+			const uint32_t rowSize = tile.endX - tile.x;
+
+			if (!m_UseTileBuffers)
+			{
+				for (uint32_t py{ tile.y + offsetY }; py < tile.endY; py += step)
+				{
+					for (uint32_t px{ tile.x + offsetX }; px < tile.endX; px += step)
+					{
+						const uint32_t pixelIndex = px + (py * m_RenderWidth);
+						GBufferSample* const pGBufferSample = pGBuffer ? pGBuffer + pixelIndex : nullptr;
+
+						if (m_UsePPTPixelMapping)
+							m_HdrPixels[pixelIndex] = RenderPixel(pScene, pixelIndex, fov, aspectRatio, camera, lights, materials, pGBufferSample);
+						else
+							m_HdrPixels[pixelIndex] = RenderPixel(pScene, pixelIndex, multiply, camera, lights, materials, pGBufferSample);
+					}
+				}
+				return;
+			}
+
+			//Trace into a buffer on this thread's stack, the shared buffer only sees one burst of whole rows per tile.
+			//A tile row is 32 * 12 bytes, so the rows in here start on a cache line as well
+			alignas(g_CacheLineSize) ColorRGB tileColors[m_TileSize * m_TileSize];
+
+			//A partial pass keeps the pixels it doesn't trace, they are copied in so the rows can be committed whole
+			if (step > 1)
+			{
+				for (uint32_t py{ tile.y }; py < tile.endY; ++py)
+				{
+					std::copy_n(&m_HdrPixels[tile.x + (py * m_RenderWidth)], rowSize, &tileColors[(py - tile.y) * m_TileSize]);
+				}
+			}
+
+			for (uint32_t py{ tile.y + offsetY }; py < tile.endY; py += step)
+			{
+				ColorRGB* pTileRow = &tileColors[(py - tile.y) * m_TileSize];
+				for (uint32_t px{ tile.x + offsetX }; px < tile.endX; px += step)
+				{
+					const uint32_t pixelIndex = px + (py * m_RenderWidth);
+					GBufferSample* const pGBufferSample = pGBuffer ? pGBuffer + pixelIndex : nullptr;
+
+					if (m_UsePPTPixelMapping)
+						pTileRow[px - tile.x] = RenderPixel(pScene, pixelIndex, fov, aspectRatio, camera, lights, materials, pGBufferSample);
+					else
+						pTileRow[px - tile.x] = RenderPixel(pScene, pixelIndex, multiply, camera, lights, materials, pGBufferSample);
+				}
+			}
+
+			for (uint32_t py{ tile.y }; py < tile.endY; ++py)
+			{
+				std::copy_n(&tileColors[(py - tile.y) * m_TileSize], rowSize, &m_HdrPixels[tile.x + (py * m_RenderWidth)]);
+			}
+		});
+}
+
+void Renderer::ShadePass(Scene* pScene)
+{
+	//Local variables
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	ForEachTile(static_cast<uint32_t>(m_RenderWidth), static_cast<uint32_t>(m_RenderHeight), [&](const Tile& tile)
+		{
+			//Shadow rays still go through the scene
+			if (m_NumaReplicationEnabled)
+			{
+				Topology::RefreshCurrentNode();
+				pScene->SyncNodeReplica(Topology::GetCurrentNode());
+			}
+
+			for (uint32_t py{ tile.y }; py < tile.endY; ++py)
+			{
+				for (uint32_t px{ tile.x }; px < tile.endX; ++px)
+				{
+					const uint32_t pixelIndex = px + (py * m_RenderWidth);
+					m_HdrPixels[pixelIndex] = ShadeSample(pScene, m_GBuffer[pixelIndex], lights, materials);
+				}
+			}
+		});
+}
+
+bool Renderer::FindDirtyTiles(Scene* pScene, const Camera& camera)
+{
+	const std::vector<Light>& lights = pScene->GetLights();
+	const std::vector<TriangleMesh>& meshes = pScene->GetTriangleMeshGeometries();
+
+	//Only meshes are tracked per tile, added meshes or any changed sphere or plane retrace everything
+	//(changed lights are part of the view state already)
+	if (pScene->GetPrimitiveVersion() != m_LastPrimitiveVersion || meshes.size() != m_LastMeshStates.size())
+		return false;
+
+	const uint32_t nrTilesX = (m_RenderWidth + m_TileSize - 1) / m_TileSize;
+	const uint32_t nrTilesY = (m_RenderHeight + m_TileSize - 1) / m_TileSize;
+	m_DirtyTiles.assign(static_cast<size_t>(nrTilesX) * nrTilesY, 0);
+
+	//A moved (or re-materialed) mesh changes the pixels it covered and the ones it covers now, including the shadows of both
+	for (size_t i{ 0 }; i < meshes.size(); ++i)
+	{
+		const TriangleMesh& mesh = meshes[i];
+		const MeshState& lastState = m_LastMeshStates[i];
+		if (mesh.transformVersion == lastState.transformVersion && mesh.materialIndex == lastState.materialIndex && mesh.cullMode == lastState.cullMode)
+			continue;
+
+		if (!MarkDirtyBounds(lastState.minAABB, lastState.maxAABB, camera, lights, pScene->GetPlaneGeometries())
+			|| !MarkDirtyBounds(mesh.transformedMinAABB, mesh.transformedMaxAABB, camera, lights, pScene->GetPlaneGeometries()))
+			return false;
+	}
+
+	return true;
+}
+
+bool Renderer::MarkDirtyBounds(const Vector3& minAABB, const Vector3& maxAABB, const Camera& camera, const std::vector<Light>& lights, const std::vector<Plane>& planes)
+{
+	ConvexRegion box{};
+	for (int i{ 0 }; i < 8; ++i)
+	{
+		box.points.push_back({ i & 1 ? maxAABB.x : minAABB.x, i & 2 ? maxAABB.y : minAABB.y, i & 4 ? maxAABB.z : minAABB.z });
+	}
+
+	//Anything behind a plane the camera is in front of is hidden by it
+	std::vector<const Plane*> occludingPlanes{};
+	for (const Plane& plane : planes)
+	{
+		if (Vector3::Dot(camera.origin - plane.origin, plane.normal) > 0.f)
+			occludingPlanes.push_back(&plane);
+	}
+
+	const Vector3 nearOrigin = camera.origin + camera.forward * g_DirtyRegionNearDepth;
+	const float multiply{ 2.f * camera.fov / static_cast<float>(m_RenderHeight) };
+
+	//Screen bounds of the visible part of the region. Each occluding plane clips it on its own, the resulting bounds all hold,
+	//so their overlap does too (clipping by every plane in sequence would be tighter, but the point sets grow quickly)
+	ScreenRect bounds{};
+	const auto addRegion = [&](const ConvexRegion& region)
+		{
+			ScreenRect regionBounds{};
+			if (!ProjectRegion(ClipRegion(region, nearOrigin, camera.forward), camera, multiply, m_XAddition, m_YAddition, regionBounds))
+				regionBounds = ScreenRect::Unbounded();
+
+			for (const Plane* pPlane : occludingPlanes)
+			{
+				ScreenRect planeBounds{};
+				const ConvexRegion visibleRegion = ClipRegion(ClipRegion(region, pPlane->origin, pPlane->normal), nearOrigin, camera.forward);
+				if (ProjectRegion(visibleRegion, camera, multiply, m_XAddition, m_YAddition, planeBounds))
+					regionBounds = regionBounds.Intersect(planeBounds);
+			}
+
+			bounds = bounds.Union(regionBounds);
+		};
+
+	if (!m_ShadowsEnabled || lights.empty())
+	{
+		addRegion(box);
+	}
+	else
+	{
+		//The box plus its shadow: every point of the box moved away from the light, which is the box plus every
+		//non-negative combination of the directions from the light through its corners
+		for (const Light& light : lights)
+		{
+			ConvexRegion shadowVolume{ box };
+			for (const Vector3& corner : box.points)
+			{
+				shadowVolume.directions.push_back(light.type == LightType::Point ? corner - light.origin : light.direction);
+			}
+			addRegion(shadowVolume);
+		}
+	}
+
+	if (bounds.IsUnbounded())
+		return false;
+
+	//Pixel centers are at whole numbers, one pixel of margin covers the rays in between
+	const float width = static_cast<float>(m_RenderWidth);
+	const float height = static_cast<float>(m_RenderHeight);
+	if (bounds.IsEmpty() || bounds.maxX < -1.f || bounds.maxY < -1.f || bounds.minX > width || bounds.minY > height)
+		return true;
+
+	const uint32_t minTileX = static_cast<uint32_t>(std::clamp(bounds.minX - 1.f, 0.f, width - 1.f)) / m_TileSize;
+	const uint32_t minTileY = static_cast<uint32_t>(std::clamp(bounds.minY - 1.f, 0.f, height - 1.f)) / m_TileSize;
+	const uint32_t maxTileX = static_cast<uint32_t>(std::clamp(bounds.maxX + 1.f, 0.f, width - 1.f)) / m_TileSize;
+	const uint32_t maxTileY = static_cast<uint32_t>(std::clamp(bounds.maxY + 1.f, 0.f, height - 1.f)) / m_TileSize;
+
+	const uint32_t nrTilesX = (m_RenderWidth + m_TileSize - 1) / m_TileSize;
+	for (uint32_t tileY{ minTileY }; tileY <= maxTileY; ++tileY)
+	{
+		for (uint32_t tileX{ minTileX }; tileX <= maxTileX; ++tileX)
+		{
+			m_DirtyTiles[tileY * nrTilesX + tileX] = 1;
+		}
+	}
+
+	return true;
+}
 
-//#define RENDERPIXEL_PPT_EXAMPLE
-#define LIGHTING_MODE_CYCLING
+void Renderer::StoreSceneState(Scene* pScene)
+{
+	const std::vector<TriangleMesh>& meshes = pScene->GetTriangleMeshGeometries();
+	m_LastMeshStates.resize(meshes.size());
+	for (size_t i{ 0 }; i < meshes.size(); ++i)
+	{
+		m_LastMeshStates[i] = { meshes[i].transformVersion, meshes[i].materialIndex, meshes[i].cullMode, meshes[i].transformedMinAABB, meshes[i].transformedMaxAABB };
+	}
 
+	m_LastPrimitiveVersion = pScene->GetPrimitiveVersion();
+}
 
-Renderer::Renderer(SDL_Window * pWindow) :
-	m_pWindow(pWindow),
-	m_pBuffer(SDL_GetWindowSurface(pWindow))
+void Renderer::AccumulateFrame(Scene* pScene, const Camera& camera)
 {
-	//Initialize
-	SDL_GetWindowSize(pWindow, &m_Width, &m_Height);
-	m_pBufferPixels = static_cast<uint32_t*>(m_pBuffer->pixels);
+	//Converged, the buffer still holds the averaged image
+	if (m_NrAccumulatedFrames >= m_MaxAccumulatedFrames)
+		return;
+
+	//The last (unjittered) frame is the first sample
+	if (m_NrAccumulatedFrames == 0)
+	{
+		m_AccumulatedPixels = m_HdrPixels;
+		m_NrAccumulatedFrames = 1;
+	}
 
-	m_XAddition = (1.f - m_Width) / 2.f;
-	m_YAddition = (m_Height - 1.f) / 2.f;
+	//Sub-pixel offset in [-0.5, 0.5), the Halton (2, 3) points cover the pixel evenly for any number of frames
+	m_JitterX = Halton(m_NrAccumulatedFrames, 2) - 0.5f;
+	m_JitterY = Halton(m_NrAccumulatedFrames, 3) - 0.5f;
+	TracePass(pScene, camera, 0, 0, 1);
+	m_JitterX = 0.f;
+	m_JitterY = 0.f;
+
+	if (m_CancelRequested.load())
+		return;
+
+	//Running average, every frame gets the same weight
+	++m_NrAccumulatedFrames;
+	const float weight = 1.f / m_NrAccumulatedFrames;
+
+	ForEachTile(static_cast<uint32_t>(m_RenderWidth), static_cast<uint32_t>(m_RenderHeight), [&](const Tile& tile)
+		{
+			for (uint32_t py{ tile.y }; py < tile.endY; ++py)
+			{
+				for (uint32_t px{ tile.x }; px < tile.endX; ++px)
+				{
+					const uint32_t pixelIndex = px + (py * m_RenderWidth);
+					const ColorRGB& sample = m_HdrPixels[pixelIndex];
+					ColorRGB& average = m_AccumulatedPixels[pixelIndex];
+					average = average * (1.f - weight) + sample * weight;
+				}
+			}
+		});
 }
 
-void Renderer::Render(Scene* pScene) const
+void Renderer::FillProgressiveGaps()
 {
-	//Local variables
-	Camera& camera = pScene->GetCamera();
-	auto& materials = pScene->GetMaterials();
-	auto& lights = pScene->GetLights();
+	//Every pixel that isn't traced yet copies the closest traced pixel of the coarser pattern:
+	//the top-left pixel of its 2x2 block if that one is done, otherwise the top-left pixel of its 4x4 block (always traced first)
+	ForEachTile(static_cast<uint32_t>(m_RenderWidth), static_cast<uint32_t>(m_RenderHeight), [&](const Tile& tile)
+		{
+			for (uint32_t py{ tile.y }; py < tile.endY; ++py)
+			{
+				const uint32_t offsetY = py % g_ProgressivePatternSize;
+				for (uint32_t px{ tile.x }; px < tile.endX; ++px)
+				{
+					const uint32_t offsetX = px % g_ProgressivePatternSize;
+					if (g_ProgressivePhaseOfOffset[offsetY][offsetX] < m_NrProgressivePhases)
+						continue;
 
-	const uint32_t nrPixels = m_Width * m_Height;
+					uint32_t sourceX = px & ~1u;
+					uint32_t sourceY = py & ~1u;
+					if (g_ProgressivePhaseOfOffset[offsetY & ~1u][offsetX & ~1u] >= m_NrProgressivePhases)
+					{
+						sourceX = px & ~3u;
+						sourceY = py & ~3u;
+					}
 
-#if defined(RENDERPIXEL_PPT_EXAMPLE)
-	const float fov = camera.fov;
-	const float aspectRatio = m_Width / static_cast<float>(m_Height);
-#else
-	float multiply{ 2.f * camera.fov / (float)m_Height };
-#endif
+					m_HdrPixels[px + (py * m_RenderWidth)] = m_HdrPixels[sourceX + (sourceY * m_RenderWidth)];
+					if (UsesGBuffer())
+						m_GBuffer[px + (py * m_RenderWidth)] = m_GBuffer[sourceX + (sourceY * m_RenderWidth)];
+				}
+			}
+		});
+}
+
+void Renderer::ForEachTile(uint32_t width, uint32_t height, const std::function<void(const Tile&)>& tileTask)
+{
+	//Every task handles one tile of the screen
+	const uint32_t nrTilesX = (width + m_TileSize - 1) / m_TileSize;
+	const uint32_t nrTilesY = (height + m_TileSize - 1) / m_TileSize;
 
+	m_Scheduler.Run(nrTilesX * nrTilesY, [&](uint32_t tileIndex)
+		{
+			//Frame got canceled, skip the remaining tiles
+			if (m_CancelRequested.load(std::memory_order_relaxed))
+				return;
 
-	//Render Pixel implementation
-#if defined(ASYNC)
-	//Async Logic
-	const uint32_t nrCores = std::thread::hardware_concurrency();
-	std::vector<std::future<void>> async_futures{};
-	const uint32_t nrPixelsPerTask = nrPixels / nrCores;
-	uint32_t nrUnassignedPixels = nrPixels % nrCores;
-	uint32_t currPixelIndex = 0;
+			Tile tile{};
+			tile.x = (tileIndex % nrTilesX) * m_TileSize;
+			tile.y = (tileIndex / nrTilesX) * m_TileSize;
+			tile.endX = std::min(tile.x + m_TileSize, width);
+			tile.endY = std::min(tile.y + m_TileSize, height);
 
-	for (uint32_t coreId{ 0 }; coreId < nrCores; ++coreId)
-	{
-		uint32_t taskSize = nrPixelsPerTask;
-		if (nrUnassignedPixels > 0)
+			tileTask(tile);
+		});
+}
+
+void Renderer::Resolve()
+{
+	const auto& radiance = GetRadiance();
+
+	ForEachTile(static_cast<uint32_t>(m_RenderWidth), static_cast<uint32_t>(m_RenderHeight), [&](const Tile& tile)
 		{
-			++taskSize;
-			--nrUnassignedPixels;
-		}
+			//Row by row, the tone mapping and packing are vectorized over the contiguous pixels
+			std::array<ColorRGB, m_TileSize> displayColors;
+			const uint32_t rowSize = tile.endX - tile.x;
 
-		async_futures.push_back(std::async(std::launch::async, [=, this] {
-			//Render all pixels for this task (currPixelIndex > currPixelIndex + taskSize)
-			const uint32_t pixelIndexEnd = currPixelIndex + taskSize;
-			for (uint32_t pixelIndex{ currPixelIndex }; pixelIndex < pixelIndexEnd; ++pixelIndex)
+			for (uint32_t py{ tile.y }; py < tile.endY; ++py)
 			{
-			#if defined(RENDERPIXEL_PPT_EXAMPLE)
-				RenderPixel(pScene, pixelIndex, fov, aspectRatio, camera, lights, materials);
-			#else
-				RenderPixel(pScene, pixelIndex, multiply, camera, lights, materials);
-			#endif
+				const uint32_t rowStart = tile.x + (py * m_RenderWidth);
+				m_ToneMapper.Apply(&radiance[rowStart], displayColors.data(), rowSize);
+				m_PixelPacker.Pack(displayColors.data(), m_pRenderPixels + rowStart, rowSize);
 			}
-			}));
+		});
+}
 
-		currPixelIndex += taskSize;
-	}
+void Renderer::Upscale()
+{
+	//Bilinear filter from the render buffer to the window surface
+	const float scaleX = m_RenderWidth / static_cast<float>(m_Width);
+	const float scaleY = m_RenderHeight / static_cast<float>(m_Height);
+	const int maxX = m_RenderWidth - 1;
+	const int maxY = m_RenderHeight - 1;
 
-	//Wait for async completion for all tasks
-	for (const std::future<void>& f : async_futures)
-	{
-		f.wait();
-	}
-#elif defined(PARALLEL_FOR)
-	//Parellel-For Logic
-	concurrency::parallel_for(0u, nrPixels, [=, this](int i)
+	ForEachTile(static_cast<uint32_t>(m_Width), static_cast<uint32_t>(m_Height), [&](const Tile& tile)
 		{
-		#if defined(RENDERPIXEL_PPT_EXAMPLE)
-			RenderPixel(pScene, i, fov, aspectRatio, camera, lights, materials);
-		#else
-			RenderPixel(pScene, i, multiply, camera, lights, materials);
-		#endif
+			for (uint32_t py{ tile.y }; py < tile.endY; ++py)
+			{
+				const float sourceY = std::max((py + 0.5f) * scaleY - 0.5f, 0.f);
+				const int y0 = std::min(static_cast<int>(sourceY), maxY);
+				const int y1 = std::min(y0 + 1, maxY);
+				const uint32_t weightY = static_cast<uint32_t>((sourceY - y0) * 256.f);
+
+				const uint32_t* pRow0 = m_pRenderPixels + y0 * m_RenderWidth;
+				const uint32_t* pRow1 = m_pRenderPixels + y1 * m_RenderWidth;
+
+				for (uint32_t px{ tile.x }; px < tile.endX; ++px)
+				{
+					const float sourceX = std::max((px + 0.5f) * scaleX - 0.5f, 0.f);
+					const int x0 = std::min(static_cast<int>(sourceX), maxX);
+					const int x1 = std::min(x0 + 1, maxX);
+					const uint32_t weightX = static_cast<uint32_t>((sourceX - x0) * 256.f);
+
+					const uint32_t top = LerpPacked(pRow0[x0], pRow0[x1], weightX);
+					const uint32_t bottom = LerpPacked(pRow1[x0], pRow1[x1], weightX);
+					m_pBufferPixels[px + (py * m_Width)] = LerpPacked(top, bottom, weightY);
+				}
+			}
 		});
-#else
-	//Synchronous Logic (no threading)
-	for (uint32_t i{ 0 }; i < nrPixels; ++i)
+}
+
+void Renderer::UpscaleEdgeAware()
+{
+	//Same sample positions as the bilinear filter. Between source pixels on the same surface it interpolates the same way,
+	//across a silhouette or crease the transition is squeezed into one output pixel, as sharp as if it was traced at the output resolution
+	const float scaleX = m_RenderWidth / static_cast<float>(m_Width);
+	const float scaleY = m_RenderHeight / static_cast<float>(m_Height);
+	const int maxX = m_RenderWidth - 1;
+	const int maxY = m_RenderHeight - 1;
+	const float edgeSharpnessX = 1.f / scaleX;
+	const float edgeSharpnessY = 1.f / scaleY;
+
+	const auto isSameSurface = [](const GBufferSample& sample, const GBufferSample& reference)
+		{
+			if (sample.didHit != reference.didHit)
+				return false;
+
+			//Distance to the reference's tangent plane rather than the depth difference, so planes seen at a grazing angle stay one surface
+			return !sample.didHit || (sample.objectIndex == reference.objectIndex
+				&& std::abs((sample.position - reference.position) * reference.normal) <= g_UpscaleDepthTolerance * reference.depth
+				&& sample.normal * reference.normal >= g_UpscaleNormalThreshold);
+		};
+
+	//Flag every source pixel whose 2x2 footprint (itself and the pixels right, below and below right of it) covers more than one surface
+	m_UpscaleEdges.resize(m_GBuffer.size());
+	ForEachTile(static_cast<uint32_t>(m_RenderWidth), static_cast<uint32_t>(m_RenderHeight), [&](const Tile& tile)
+		{
+			for (uint32_t py{ tile.y }; py < tile.endY; ++py)
+			{
+				const uint32_t y1 = std::min(static_cast<int>(py) + 1, maxY);
+				for (uint32_t px{ tile.x }; px < tile.endX; ++px)
+				{
+					const uint32_t x1 = std::min(static_cast<int>(px) + 1, maxX);
+					const GBufferSample& reference = m_GBuffer[px + (py * m_RenderWidth)];
+					m_UpscaleEdges[px + (py * m_RenderWidth)] = !isSameSurface(m_GBuffer[x1 + (py * m_RenderWidth)], reference)
+						|| !isSameSurface(m_GBuffer[px + (y1 * m_RenderWidth)], reference)
+						|| !isSameSurface(m_GBuffer[x1 + (y1 * m_RenderWidth)], reference);
+				}
+			}
+		});
+
+	ForEachTile(static_cast<uint32_t>(m_Width), static_cast<uint32_t>(m_Height), [&](const Tile& tile)
+		{
+			for (uint32_t py{ tile.y }; py < tile.endY; ++py)
+			{
+				const float sourceY = std::max((py + 0.5f) * scaleY - 0.5f, 0.f);
+				const int y0 = std::min(static_cast<int>(sourceY), maxY);
+				const int y1 = std::min(y0 + 1, maxY);
+				const float weightY = sourceY - y0;
+				const float edgeWeightY = std::clamp((weightY - 0.5f) * edgeSharpnessY + 0.5f, 0.f, 1.f);
+
+				for (uint32_t px{ tile.x }; px < tile.endX; ++px)
+				{
+					const float sourceX = std::max((px + 0.5f) * scaleX - 0.5f, 0.f);
+					const int x0 = std::min(static_cast<int>(sourceX), maxX);
+					const int x1 = std::min(x0 + 1, maxX);
+					const float weightX = sourceX - x0;
+
+					const bool isEdge = m_UpscaleEdges[x0 + (y0 * m_RenderWidth)];
+					const uint32_t u = static_cast<uint32_t>((isEdge ? std::clamp((weightX - 0.5f) * edgeSharpnessX + 0.5f, 0.f, 1.f) : weightX) * 256.f);
+					const uint32_t v = static_cast<uint32_t>((isEdge ? edgeWeightY : weightY) * 256.f);
+
+					//Fixed point bilinear weights adding up to 256
+					uint32_t weights[4]{ ((256 - u) * (256 - v)) >> 8, (u * (256 - v)) >> 8, ((256 - u) * v) >> 8, 0 };
+					weights[3] = 256 - weights[0] - weights[1] - weights[2];
+
+					const uint32_t sourcePixels[4]{ m_pRenderPixels[x0 + (y0 * m_RenderWidth)], m_pRenderPixels[x1 + (y0 * m_RenderWidth)],
+						m_pRenderPixels[x0 + (y1 * m_RenderWidth)], m_pRenderPixels[x1 + (y1 * m_RenderWidth)] };
+					m_pBufferPixels[px + (py * m_Width)] = BlendPacked(sourcePixels, weights);
+				}
+			}
+		});
+}
+
+void Renderer::SetRenderScale(float scale)
+{
+	CancelFrame();
+
+	const int renderWidth = std::max(static_cast<int>(m_Width * scale + 0.5f), 1);
+	const int renderHeight = std::max(static_cast<int>(m_Height * scale + 0.5f), 1);
+	if (renderWidth == m_RenderWidth && renderHeight == m_RenderHeight)
+		return;
+
+	m_RenderWidth = renderWidth;
+	m_RenderHeight = renderHeight;
+
+	//Full resolution traces straight into the window surface
+	if (m_RenderWidth == m_Width && m_RenderHeight == m_Height)
 	{
-	#if defined(RENDERPIXEL_PPT_EXAMPLE)
-		RenderPixel(pScene, i, fov, aspectRatio, camera, lights, materials);
-	#else
-		RenderPixel(pScene, i, multiply, camera, lights, materials);
-	#endif
+		m_ScaledPixels = {};
+		m_pRenderPixels = m_pBufferPixels;
+	}
+	else
+	{
+		m_ScaledPixels.assign(static_cast<size_t>(m_RenderWidth) * m_RenderHeight, 0);
+		m_pRenderPixels = m_ScaledPixels.data();
 	}
-#endif
 
+	m_HdrPixels.assign(static_cast<size_t>(m_RenderWidth) * m_RenderHeight, {});
 
-	//@END
-	//Update SDL Surface
-	SDL_UpdateWindowSurface(m_pWindow);
+	m_XAddition = (1.f - m_RenderWidth) / 2.f;
+	m_YAddition = (m_RenderHeight - 1.f) / 2.f;
+}
+
+void Renderer::UpdateDynamicResolution(float frameTime)
+{
+	if (!m_DynamicResolutionEnabled)
+		return;
+
+	if (m_DynamicResolution.Update(frameTime))
+		SetRenderScale(m_DynamicResolution.GetScale());
+}
+
+void Renderer::SetFixedRenderScale(float scale)
+{
+	m_FixedRenderScale = std::clamp(scale, g_MinFixedRenderScale, 1.f);
+
+	if (!m_DynamicResolutionEnabled)
+		SetRenderScale(m_FixedRenderScale);
+}
+
+void Renderer::ToggleDynamicResolution()
+{
+	m_DynamicResolutionEnabled = !m_DynamicResolutionEnabled;
+
+	m_DynamicResolution.Reset();
+	SetRenderScale(m_DynamicResolutionEnabled ? m_DynamicResolution.GetScale() : m_FixedRenderScale);
+}
+
+Renderer::ViewState Renderer::GetViewState(Scene* pScene, const Camera& camera) const
+{
+	ViewState viewState{};
+	viewState.cameraOrigin = camera.origin;
+	viewState.cameraForward = camera.forward;
+	viewState.fov = camera.fov;
+	viewState.geometryVersion = pScene->GetGeometryVersion();
+	viewState.lightingMode = m_CurrentLightingMode;
+	viewState.shadowsEnabled = m_ShadowsEnabled;
+	viewState.lightsHash = HashLights(pScene->GetLights());
+	viewState.usePPTPixelMapping = m_UsePPTPixelMapping;
+	viewState.renderWidth = m_RenderWidth;
+	viewState.renderHeight = m_RenderHeight;
+	return viewState;
+}
+
+bool Renderer::ViewState::IsEqual(const ViewState& other) const
+{
+	return IsEqualExceptGeometry(other) && geometryVersion == other.geometryVersion;
+}
+
+bool Renderer::ViewState::IsEqualExceptGeometry(const ViewState& other) const
+{
+	return cameraOrigin.x == other.cameraOrigin.x && cameraOrigin.y == other.cameraOrigin.y && cameraOrigin.z == other.cameraOrigin.z
+		&& cameraForward.x == other.cameraForward.x && cameraForward.y == other.cameraForward.y && cameraForward.z == other.cameraForward.z
+		&& fov == other.fov
+		&& lightingMode == other.lightingMode
+		&& shadowsEnabled == other.shadowsEnabled
+		&& lightsHash == other.lightsHash
+		&& usePPTPixelMapping == other.usePPTPixelMapping
+		&& renderWidth == other.renderWidth && renderHeight == other.renderHeight;
+}
+
+bool Renderer::ViewState::HasSameSurfaces(const ViewState& other) const
+{
+	return cameraOrigin.x == other.cameraOrigin.x && cameraOrigin.y == other.cameraOrigin.y && cameraOrigin.z == other.cameraOrigin.z
+		&& cameraForward.x == other.cameraForward.x && cameraForward.y == other.cameraForward.y && cameraForward.z == other.cameraForward.z
+		&& fov == other.fov
+		&& geometryVersion == other.geometryVersion
+		&& usePPTPixelMapping == other.usePPTPixelMapping
+		&& renderWidth == other.renderWidth && renderHeight == other.renderHeight;
+}
+
+ColorRGB Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float multiply, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials, GBufferSample* pGBufferSample) const
+{
+	const int px = pixelIndex % m_RenderWidth;
+	const int py = pixelIndex / m_RenderWidth;
+
+	float cx{ multiply * (px + m_XAddition + m_JitterX) };
+	float cy{ multiply * (-py + m_YAddition - m_JitterY) };
+
+	//Convert camera space to world space
+	Vector3 rayDirection = (cx * camera.right + cy * camera.up + camera.forward).Normalized();
+
+	return TraceViewRay(pScene, camera, rayDirection, lights, materials, pGBufferSample);
 }
 
-void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float multiply, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const
+ColorRGB Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials, GBufferSample* pGBufferSample) const
 {
-	const int px = pixelIndex % m_Width;
-	const int py = pixelIndex / m_Width;
+	const int px = pixelIndex % m_RenderWidth;
+	const int py = pixelIndex / m_RenderWidth;
 
-	float cx{ multiply * (px + m_XAddition) };
-	float cy{ multiply * (-py + m_YAddition) };
+	float rx = px + 0.5f + m_JitterX;
+	float ry = py + 0.5f + m_JitterY;
+
+	float cx = (2 * (rx / float(m_RenderWidth)) - 1) * aspectRatio * fov;
+	float cy = (1 - (2 * (ry / float(m_RenderHeight)))) * fov;
 
 	//Convert camera space to world space
 	Vector3 rayDirection = (cx * camera.right + cy * camera.up + camera.forward).Normalized();
 
+	return TraceViewRay(pScene, camera, rayDirection, lights, materials, pGBufferSample);
+}
+
+ColorRGB Renderer::TraceViewRay(Scene* pScene, const Camera& camera, const Vector3& rayDirection, const std::vector<Light>& lights, const std::vector<Material*>& materials, GBufferSample* pGBufferSample) const
+{
+	const GBufferSample sample = TracePrimaryHit(pScene, camera, rayDirection);
+	if (pGBufferSample)
+		*pGBufferSample = sample;
+
+	return ShadeSample(pScene, sample, lights, materials);
+}
+
+Renderer::GBufferSample Renderer::TracePrimaryHit(Scene* pScene, const Camera& camera, const Vector3& rayDirection) const
+{
 	//Ray we are casting from the camera towards each pixel
 	Ray viewRay{ camera.origin, rayDirection };
 
-	//Color to write to the color buffer
-	ColorRGB finalColor{};
-
 	//HitRecord containing more information about a potential hit
 	HitRecord closestHit{};
 	pScene->GetClosestHit(viewRay, closestHit);
 
+	GBufferSample sample{};
+	sample.rayDirection = rayDirection;
+	sample.didHit = closestHit.didHit;
 	if (closestHit.didHit)
 	{
+		sample.position = closestHit.origin;
+		sample.normal = closestHit.normal.Normalized();
+		sample.depth = closestHit.t;
+		sample.objectIndex = closestHit.objectIndex;
+		sample.materialIndex = closestHit.materialIndex;
+	}
+	return sample;
+}
+
+ColorRGB Renderer::ShadeSample(Scene* pScene, const GBufferSample& sample, const std::vector<Light>& lights, const std::vector<Material*>& materials) const
+{
+	//Color to write to the color buffer
+	ColorRGB finalColor{};
+
+	if (sample.didHit)
+	{
+		HitRecord closestHit{};
+		closestHit.origin = sample.position;
+		closestHit.normal = sample.normal;
+		closestHit.didHit = true;
+		closestHit.materialIndex = sample.materialIndex;
+
+		const Vector3& rayDirection = sample.rayDirection;
+
 		//If we hit something, keep track of the material color
 		Material* const mat = materials[closestHit.materialIndex];
 
-		//Normalize closest hit normal
-		closestHit.normal.Normalize();
-
 		for (const Light& light : lights)
 		{
 #if defined(LIGHTING_MODE_CYCLING)
@@ -202,112 +1540,274 @@ void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float multiply, c
 		}
 	}
 
-	//Update Color in Buffer
-	finalColor.MaxToOne();
+	return finalColor;
+}
 
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+void Renderer::CaptureFrame(FrameQueue& frameQueue) const
+{
+	frameQueue.Push(static_cast<const uint32_t*>(GetFinishedFrame()->pixels), static_cast<uint32_t>(m_Width), static_cast<uint32_t>(m_Height), m_PixelPacker.GetLayout());
 }
-void Renderer::RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const
+
+bool Renderer::WriteImage(const std::string& filename) const
 {
-	const int px = pixelIndex % m_Width;
-	const int py = pixelIndex / m_Width;
+	//EXR gets the unclamped radiance, as long as it was traced at the output resolution
+	ImageFormat format{};
+	if (ImageStripWriter::TryGetFormat(filename, format) && format == ImageFormat::EXR && m_RenderWidth == m_Width && m_RenderHeight == m_Height)
+		return ImageWriter::WriteEXR(filename, &GetRadiance()[0].r, static_cast<uint32_t>(m_Width), static_cast<uint32_t>(m_Height));
+
+	const SDL_Surface* pFrame = GetFinishedFrame();
+	const uint32_t* pFramePixels = static_cast<const uint32_t*>(pFrame->pixels);
 
-	float rx = px + 0.5f;
-	float ry = py + 0.5f;
+	std::vector<uint8_t> rgbPixels(static_cast<size_t>(m_Width) * m_Height * 3);
+	for (size_t i{ 0 }; i < static_cast<size_t>(m_Width) * m_Height; ++i)
+	{
+		SDL_GetRGB(pFramePixels[i], pFrame->format, &rgbPixels[i * 3], &rgbPixels[i * 3 + 1], &rgbPixels[i * 3 + 2]);
+	}
 
-	float cx = (2 * (rx / float(m_Width)) - 1) * aspectRatio * fov;
-	float cy = (1 - (2 * (ry / float(m_Height)))) * fov;
+	return ImageWriter::Write(filename, rgbPixels.data(), static_cast<uint32_t>(m_Width), static_cast<uint32_t>(m_Height));
+}
 
-	//Convert camera space to world space
-	Vector3 rayDirection = (cx * camera.right + cy * camera.up + camera.forward).Normalized();
+bool Renderer::RenderToImage(Scene* pScene, const std::string& filename, uint32_t width, uint32_t height)
+{
+	CancelFrame();
 
-	//Ray we are casting from the camera towards each pixel
-	Ray viewRay{ camera.origin, rayDirection };
+	ImageFormat format{};
+	if (!ImageStripWriter::TryGetFormat(filename, format))
+		return false;
 
-	//Color to write to the color buffer
-	ColorRGB finalColor{};
+	ImageStripWriter writer{ filename, format, width, height };
+	if (!writer.IsOpen())
+		return false;
 
-	//HitRecord containing more information about a potential hit
-	HitRecord closestHit{};
-	pScene->GetClosestHit(viewRay, closestHit);
+	//Refresh (or release) the per node copies of the scene geometry
+	pScene->UpdateNodeReplicas(m_NumaReplicationEnabled ? Topology::GetNrNodes() : 0);
 
-	if (closestHit.didHit)
+	//Local variables
+	const Camera& camera = pScene->GetCamera();
+	auto& materials = pScene->GetMaterials();
+	auto& lights = pScene->GetLights();
+
+	//Pixel mapping parameters for the full image (both mappings give the same rays)
+	const float multiply{ 2.f * camera.fov / static_cast<float>(height) };
+	const float xAddition{ (1.f - width) / 2.f };
+	const float yAddition{ (height - 1.f) / 2.f };
+
+	//EXR keeps the unclamped radiance, the other formats get tone mapped
+	const bool isHdrOutput = format == ImageFormat::EXR;
+
+	//Strips are one tile high. While one is traced, the previous one is written on another thread,
+	//so two strip buffers are all the pixel memory this needs
+	const size_t stripSize = static_cast<size_t>(width) * m_TileSize;
+	std::vector<ColorRGB> strips[2]{ std::vector<ColorRGB>(stripSize), std::vector<ColorRGB>(stripSize) };
+	std::future<bool> writeFuture{};
+	bool isWritten{ true };
+
+	for (uint32_t stripY{ 0 }, stripIndex{ 0 }; stripY < height && isWritten; stripY += m_TileSize, ++stripIndex)
 	{
-		//If we hit something, keep track of the material color
-		Material* const mat = materials[closestHit.materialIndex];
+		const uint32_t nrRows = std::min(m_TileSize, height - stripY);
+		std::vector<ColorRGB>& strip = strips[stripIndex % 2];
+
+		ForEachTile(width, nrRows, [&](const Tile& tile)
+			{
+				if (m_NumaReplicationEnabled)
+				{
+					Topology::RefreshCurrentNode();
+					pScene->SyncNodeReplica(Topology::GetCurrentNode());
+				}
 
-		//Normalize closest hit normal
-		closestHit.normal.Normalize();
+				for (uint32_t py{ tile.y }; py < tile.endY; ++py)
+				{
+					const float cy{ multiply * (-static_cast<float>(stripY + py) + yAddition) };
+					ColorRGB* pRow = &strip[static_cast<size_t>(py) * width];
+					for (uint32_t px{ tile.x }; px < tile.endX; ++px)
+					{
+						const float cx{ multiply * (px + xAddition) };
+						const Vector3 rayDirection = (cx * camera.right + cy * camera.up + camera.forward).Normalized();
+						pRow[px] = TraceViewRay(pScene, camera, rayDirection, lights, materials);
+					}
 
-		for (const Light& light : lights)
+					if (!isHdrOutput)
+						m_ToneMapper.Apply(pRow + tile.x, pRow + tile.x, tile.endX - tile.x);
+				}
+			});
+
+		//Rows have to reach the file in order, and the other buffer gets traced into next
+		if (writeFuture.valid())
+			isWritten = writeFuture.get();
+
+		if (isWritten)
 		{
-#if defined(LIGHTING_MODE_CYCLING)
-			//Light direction
-			Vector3 invLightDirection = LightUtils::GetDirectionToLight(light, closestHit.origin);
-			float distance = invLightDirection.Normalize();
+			writeFuture = std::async(std::launch::async, [&writer, &strip, nrRows]
+				{
+					return writer.WriteRows(&strip[0].r, nrRows);
+				});
+		}
+	}
 
-			//Shawdow
-			Ray invLightRay{ closestHit.origin, invLightDirection, 0.001f, distance };
-			if (m_ShadowsEnabled && pScene->DoesHit(invLightRay)) continue;
+	if (writeFuture.valid())
+		isWritten = writeFuture.get() && isWritten;
 
-			//Observed area (lambert cosine law)
-			float dotProduct = closestHit.normal * invLightDirection;
+	return writer.Close() && isWritten;
+}
 
-			//Lighting equation
-			switch (m_CurrentLightingMode)
-			{
-			case Renderer::LightingMode::ObservedArea:
-				if (dotProduct < 0.f) continue;
-				finalColor += {dotProduct, dotProduct, dotProduct};
-				break;
+Renderer::FullTraceScope::FullTraceScope(Renderer& renderer) :
+	m_Renderer(renderer),
+	m_WasProgressive(renderer.m_ProgressiveEnabled),
+	m_WasCheckerboard(renderer.m_CheckerboardEnabled),
+	m_WasAdaptiveSampling(renderer.m_AdaptiveSamplingEnabled),
+	m_WasAccumulating(renderer.m_AccumulationEnabled)
+{
+	m_Renderer.m_ProgressiveEnabled = false;
+	m_Renderer.m_CheckerboardEnabled = false;
+	m_Renderer.m_AdaptiveSamplingEnabled = false;
+	m_Renderer.m_AccumulationEnabled = false;
+}
 
-			case Renderer::LightingMode::Radiance:
-				finalColor += LightUtils::GetRadiance(light, closestHit.origin);
-				break;
+Renderer::FullTraceScope::~FullTraceScope()
+{
+	m_Renderer.m_ProgressiveEnabled = m_WasProgressive;
+	m_Renderer.m_NrProgressivePhases = 0;
+	m_Renderer.m_CheckerboardEnabled = m_WasCheckerboard;
+	m_Renderer.m_HasCheckerboardHistory = false;
+	m_Renderer.m_NrCheckerboardFrames = 0;
+	m_Renderer.m_AdaptiveSamplingEnabled = m_WasAdaptiveSampling;
+	m_Renderer.m_AccumulationEnabled = m_WasAccumulating;
+	m_Renderer.m_NrAccumulatedFrames = 0;
+	m_Renderer.m_LastViewState = {};
+}
 
-			case Renderer::LightingMode::BRDF:
-				finalColor += mat->Shade(closestHit, invLightDirection, -rayDirection);
-				break;
+void Renderer::RunSchedulerBenchmark(Scene* pScene, uint32_t nrFrames)
+{
+	if (nrFrames == 0)
+		return;
 
-			case Renderer::LightingMode::Combined:
-				if (dotProduct < 0.f) continue;
-				finalColor += LightUtils::GetRadiance(light, closestHit.origin) * dotProduct
-					* mat->Shade(closestHit, invLightDirection, -rayDirection);
-				break;
-			}
-#else
-			//Light direction
-			Vector3 invLightDirection = LightUtils::GetDirectionToLight(light, closestHit.origin);
-			float distance = invLightDirection.Normalize();
+	const SchedulerMode originalMode = m_Scheduler.GetMode();
 
-			//Observed area (lambert cosine law)
-			float dotProduct = closestHit.normal * invLightDirection;
-			if (dotProduct < 0.f) continue;
+	//Every benchmark frame has to be a full render
+	const FullTraceScope fullTraceScope{ *this };
 
-			//Shawdow
-			Ray invLightRay{ closestHit.origin, invLightDirection, 0.001f, distance };
-			if (m_ShadowsEnabled && pScene->DoesHit(invLightRay)) continue;
+	std::cout << "**SCHEDULER BENCHMARK STARTED** (" << nrFrames << " frames per backend, "
+		<< m_Scheduler.GetNrWorkers() << " workers)\n";
 
-			//Lighting equation
-			finalColor += LightUtils::GetRadiance(light, closestHit.origin) * dotProduct
-				* mat->Shade(closestHit, invLightDirection, -rayDirection);
-#endif
+	std::ofstream fileStream("scheduler_benchmark.txt");
+	fileStream << "FRAMES = " << nrFrames << std::endl;
+	fileStream << "WORKERS = " << m_Scheduler.GetNrWorkers() << std::endl;
+
+	std::vector<float> frameTimes(nrFrames);
+	for (int i{ 0 }; i < (int)SchedulerMode::End; ++i)
+	{
+		const SchedulerMode mode = SchedulerMode(i);
+		if (!Scheduler::IsModeAvailable(mode))
+			continue;
+
+		m_Scheduler.SetMode(mode);
+
+		//Warm up caches and worker threads, the same (unchanged) scene is rendered for every backend
+		Render(pScene);
+
+		for (float& frameTime : frameTimes)
+		{
+			const auto start = std::chrono::high_resolution_clock::now();
+			Render(pScene);
+			const auto end = std::chrono::high_resolution_clock::now();
+
+			frameTime = std::chrono::duration<float, std::milli>(end - start).count();
 		}
-	}
 
-	//Update Color in Buffer
-	finalColor.MaxToOne();
+		std::sort(frameTimes.begin(), frameTimes.end());
+		const float low = frameTimes.front();
+		const float high = frameTimes.back();
+		const float median = frameTimes[frameTimes.size() / 2];
+		const float avg = std::accumulate(frameTimes.begin(), frameTimes.end(), 0.f) / float(nrFrames);
+
+		//print
+		std::cout << ">> " << Scheduler::GetModeName(mode) << ": AVG = " << avg << "ms, MEDIAN = " << median
+			<< "ms, LOW = " << low << "ms, HIGH = " << high << "ms" << std::endl;
+
+		//file save
+		fileStream << Scheduler::GetModeName(mode) << " AVG = " << avg << " MEDIAN = " << median
+			<< " LOW = " << low << " HIGH = " << high << std::endl;
+	}
 
-	m_pBufferPixels[px + (py * m_Width)] = SDL_MapRGB(m_pBuffer->format,
-		static_cast<uint8_t>(finalColor.r * 255),
-		static_cast<uint8_t>(finalColor.g * 255),
-		static_cast<uint8_t>(finalColor.b * 255));
+	std::cout << "**SCHEDULER BENCHMARK FINISHED**\n";
+	m_Scheduler.SetMode(originalMode);
 }
 
-bool Renderer::SaveBufferToImage() const
+void Renderer::RunTileBufferBenchmark(Scene* pScene, uint32_t nrFrames)
 {
-	return SDL_SaveBMP(m_pBuffer, "RayTracing_Buffer.bmp");
+	if (nrFrames == 0)
+		return;
+
+	//Only the ThreadPool backends can change their worker count
+	const SchedulerMode originalMode = m_Scheduler.GetMode();
+	const uint32_t originalNrWorkers = m_Scheduler.GetNrWorkers();
+	const bool originalUseTileBuffers = m_UseTileBuffers;
+	m_Scheduler.SetMode(SchedulerMode::DynamicChunked);
+
+	//Every benchmark frame has to be a full render
+	const FullTraceScope fullTraceScope{ *this };
+
+	const uint32_t maxNrWorkers = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<uint32_t> workerCounts{};
+	for (uint32_t nrWorkers{ 1 }; nrWorkers < maxNrWorkers; nrWorkers *= 2)
+	{
+		workerCounts.push_back(nrWorkers);
+	}
+	workerCounts.push_back(maxNrWorkers);
+
+	std::cout << "**TILE BUFFER BENCHMARK STARTED** (" << nrFrames << " frames per run, "
+		<< m_RenderWidth << "x" << m_RenderHeight << ")\n";
+
+	std::ofstream fileStream("tile_buffer_benchmark.txt");
+	fileStream << "FRAMES = " << nrFrames << std::endl;
+
+	std::vector<float> frameTimes(nrFrames);
+	const auto measureMedian = [&]()
+		{
+			//Warm up caches and worker threads
+			Render(pScene);
+
+			for (float& frameTime : frameTimes)
+			{
+				const auto start = std::chrono::high_resolution_clock::now();
+				Render(pScene);
+				const auto end = std::chrono::high_resolution_clock::now();
+
+				frameTime = std::chrono::duration<float, std::milli>(end - start).count();
+			}
+
+			std::sort(frameTimes.begin(), frameTimes.end());
+			return frameTimes[frameTimes.size() / 2];
+		};
+
+	float singleWorkerMedian{};
+	for (uint32_t nrWorkers : workerCounts)
+	{
+		m_Scheduler.SetNrWorkers(nrWorkers);
+
+		m_UseTileBuffers = false;
+		const float directMedian = measureMedian();
+		m_UseTileBuffers = true;
+		const float tileBufferMedian = measureMedian();
+
+		if (nrWorkers == 1)
+			singleWorkerMedian = tileBufferMedian;
+
+		//Scaling is relative to one worker with tile buffers
+		const float directScaling = singleWorkerMedian / directMedian;
+		const float tileBufferScaling = singleWorkerMedian / tileBufferMedian;
+
+		//print
+		std::cout << ">> " << nrWorkers << " workers: DIRECT = " << directMedian << "ms (x" << directScaling
+			<< "), TILE BUFFERS = " << tileBufferMedian << "ms (x" << tileBufferScaling << ")" << std::endl;
+
+		//file save
+		fileStream << "WORKERS = " << nrWorkers << " DIRECT = " << directMedian << " TILEBUFFERS = " << tileBufferMedian
+			<< " DIRECTSCALING = " << directScaling << " TILEBUFFERSCALING = " << tileBufferScaling << std::endl;
+	}
+
+	std::cout << "**TILE BUFFER BENCHMARK FINISHED**\n";
+	m_Scheduler.SetNrWorkers(originalNrWorkers);
+	m_Scheduler.SetMode(originalMode);
+	m_UseTileBuffers = originalUseTileBuffers;
 }
@@ -1,8 +1,21 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "AlignedAllocator.h"
+#include "DynamicResolution.h"
+#include "FrameQueue.h"
+#include "PixelPacker.h"
+#include "Scheduler.h"
+#include "ToneMapper.h"
+#include "Vector3.h"
+
 struct SDL_Window;
 struct SDL_Surface;
 
@@ -11,39 +24,183 @@ namespace dae
 	class Scene;
 	struct Camera;
 	struct Light;
+	struct Plane;
+	enum class TriangleCullMode;
 	class Material;
+	class Presenter;
 
 	class Renderer final
 	{
 	public:
+		//Windowed, finished frames are shown by UpdateWindow
 		Renderer(SDL_Window* pWindow);
-		~Renderer() = default;
+		//Headless, renders into an owned framebuffer of the given size (nothing gets presented)
+		Renderer(int width, int height);
+		//Without any framebuffer, only RenderToImage can be used
+		Renderer();
+		~Renderer();
 
 		Renderer(const Renderer&) = delete;
 		Renderer(Renderer&&) noexcept = delete;
 		Renderer& operator=(const Renderer&) = delete;
 		Renderer& operator=(Renderer&&) noexcept = delete;
 
-		void Render(Scene* pScene) const;
-		void RenderPixel(Scene* pScene, uint32_t pixelIndex, float multiply, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const;
-		void RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials) const;
-		bool SaveBufferToImage() const;
+		//Primary hit of a pixel, everything shading it needs without tracing the view ray again
+		struct GBufferSample
+		{
+			Vector3 position{};
+			Vector3 normal{};
+			Vector3 rayDirection{};
+			//Distance along the view ray
+			float depth{};
+			uint32_t objectIndex{};
+			unsigned char materialIndex{};
+			bool didHit{ false };
+		};
+
+		//Blocking render, the finished frame is shown by the next UpdateWindow
+		void Render(Scene* pScene);
+		//Shows the newest finished frame that wasn't shown yet, without waiting for one. Call it every loop from the thread
+		//that created the window, SDL's window functions aren't thread safe
+		void UpdateWindow();
+
+		//Asynchronous rendering: the frame is traced in the background with a copy of the camera,
+		//so input keeps being processed and a frame that went stale can be canceled halfway
+		void BeginFrame(Scene* pScene);
+		//Waits at most timeoutMs for the frame in flight, returns true if it finished and got handed over for UpdateWindow
+		bool PresentFinishedFrame(uint32_t timeoutMs);
+		//Aborts the frame in flight, returns once no worker is touching the scene anymore
+		void CancelFrame();
+		//Cancels the frame in flight if the camera, scene or render settings changed since it started.
+		//A frame that already replaced a canceled one is left to finish, so a camera that keeps moving still gets frames presented
+		bool CancelStaleFrame(Scene* pScene);
+		bool IsFrameInFlight() const { return m_FrameFuture.valid(); }
+
+		//Return the HDR radiance of a render target pixel, tone mapping and writing it into the buffer is left to the resolve stage.
+		//The primary hit is stored in pGBufferSample if it isn't null
+		ColorRGB RenderPixel(Scene* pScene, uint32_t pixelIndex, float multiply, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials, GBufferSample* pGBufferSample = nullptr) const;
+		ColorRGB RenderPixel(Scene* pScene, uint32_t pixelIndex, float fov, float aspectRatio, const Camera& camera, const std::vector<Light>& lights, const std::vector<Material*>& materials, GBufferSample* pGBufferSample = nullptr) const;
+		//Writes the framebuffer as PPM, PNG or EXR (picked by extension, EXR holds the HDR radiance), returns true on success
+		bool WriteImage(const std::string& filename) const;
+		//Copies the framebuffer into the queue, the encoding and writing happens on the queue's thread
+		void CaptureFrame(FrameQueue& frameQueue) const;
+		//Renders the scene at width x height straight into a PPM, PNG or EXR (HDR) file, one strip of tile rows at a time.
+		//Finished strips are written and their memory reused, so memory use doesn't grow with the image size
+		bool RenderToImage(Scene* pScene, const std::string& filename, uint32_t width, uint32_t height);
+
+		//Renders the current scene state nrFrames times with every available scheduler backend and reports the frame times
+		void RunSchedulerBenchmark(Scene* pScene, uint32_t nrFrames = 20);
+		//Renders nrFrames frames with and without tile buffers for 1, 2, 4, ... workers and reports the frame times,
+		//shows how much writing straight into the shared buffer costs as the thread count grows
+		void RunTileBufferBenchmark(Scene* pScene, uint32_t nrFrames = 20);
 
 		void CycleLightingMode() { m_CurrentLightingMode = LightingMode(((int)m_CurrentLightingMode + 1) % (int)LightingMode::End); }
 		void ToggleShadows() { m_ShadowsEnabled = !m_ShadowsEnabled; }
+		void TogglePixelMapping() { m_UsePPTPixelMapping = !m_UsePPTPixelMapping; }
+
+		//Traced radiance is kept unclamped in a float buffer, tone mapping turns it into displayable colors afterwards
+		void CycleToneMapping() { m_ToneMapper.CycleOperator(); }
+		void SetToneMapping(ToneMappingOperator toneMappingOperator) { m_ToneMapper.SetOperator(toneMappingOperator); }
+		const char* GetToneMappingName() const { return ToneMapper::GetOperatorName(m_ToneMapper.GetOperator()); }
+		float GetExposure() const { return m_ToneMapper.GetExposure(); }
+		void SetExposure(float exposure) { m_ToneMapper.SetExposure(exposure); }
+
+		void CycleSchedulerMode() { m_Scheduler.CycleMode(); }
+		void SetSchedulerMode(SchedulerMode mode) { m_Scheduler.SetMode(mode); }
+		const char* GetSchedulerName() const { return Scheduler::GetModeName(m_Scheduler.GetMode()); }
+
+		//Pin the scheduler's worker threads to cores, spread evenly over the NUMA nodes
+		void SetThreadPinning(bool pinThreads) { m_Scheduler.SetWorkerPinning(pinThreads); }
+		//Let every NUMA node trace against its own copy of the scene geometry
+		void SetNumaReplication(bool replicate) { m_NumaReplicationEnabled = replicate; }
+
+		//Progressive mode traces an interleaved subset of the pixels per frame, as much as fits in the budget (seconds),
+		//fills the rest from the coarser samples and keeps refining while the view doesn't change
+		void ToggleProgressive() { m_ProgressiveEnabled = !m_ProgressiveEnabled; m_NrProgressivePhases = 0; }
+		void SetProgressiveBudget(float budget) { m_ProgressiveBudget = budget; }
+		bool IsProgressiveEnabled() const { return m_ProgressiveEnabled; }
+
+		//Checkerboard mode traces half of the pixels per frame, alternating between the two halves of a checkerboard.
+		//The other half is reprojected from the previous frame, or interpolated from its traced neighbours where that fails
+		void ToggleCheckerboard() { m_CheckerboardEnabled = !m_CheckerboardEnabled; m_HasCheckerboardHistory = false; m_NrCheckerboardFrames = 0; }
+		bool IsCheckerboardEnabled() const { return m_CheckerboardEnabled; }
+
+		//Adaptive sampling traces a coarse grid first and only traces the blocks in between whose corners differ
+		//(in object, normal or color), the smooth ones are interpolated from their corners
+		void ToggleAdaptiveSampling() { m_AdaptiveSamplingEnabled = !m_AdaptiveSamplingEnabled; m_LastViewState = {}; }
+		bool IsAdaptiveSamplingEnabled() const { return m_AdaptiveSamplingEnabled; }
+
+		//Accumulation keeps averaging frames with sub-pixel jittered rays while nothing changes (up to m_MaxAccumulatedFrames),
+		//so a static view converges to an anti-aliased image. Any change starts over from a single frame
+		void ToggleAccumulation() { m_AccumulationEnabled = !m_AccumulationEnabled; m_NrAccumulatedFrames = 0; }
+		bool IsAccumulationEnabled() const { return m_AccumulationEnabled; }
+		uint32_t GetNrAccumulatedFrames() const { return m_NrAccumulatedFrames; }
+
+		//When only meshes moved since the last complete frame, retrace just the tiles covered by their old and new bounds
+		//(and the shadows those cast) and keep the rest of that frame
+		void SetDirtyRegions(bool enabled) { m_DirtyRegionsEnabled = enabled; }
+		//Tiles retraced by the last frame, or every tile if it was a full render
+		uint32_t GetNrRetracedTiles() const { return m_NrRetracedTiles; }
+
+		//The G-buffer keeps the primary hit of every pixel, so when only the lighting changes (lighting mode, shadows, lights)
+		//the frame is shaded from it again instead of tracing all view rays
+		void ToggleGBuffer() { m_GBufferEnabled = !m_GBufferEnabled; m_LastViewState = {}; }
+		bool IsGBufferEnabled() const { return m_GBufferEnabled; }
+
+		//Dynamic resolution traces at a reduced internal resolution, picked from the measured frame times
+		//to hold the target frame time, and upscales the result to the window
+		void ToggleDynamicResolution();
+		void SetTargetFrameTime(float targetFrameTime) { m_DynamicResolution.SetTargetFrameTime(targetFrameTime); }
+		void UpdateDynamicResolution(float frameTime);
+		bool IsDynamicResolutionEnabled() const { return m_DynamicResolutionEnabled; }
+		float GetRenderScale() const { return m_RenderWidth / static_cast<float>(m_Width); }
+		//Render scale used while dynamic resolution is off
+		void SetFixedRenderScale(float scale);
+
+		//Upscales with an edge-aware filter that only blends source pixels on the same surface (object, depth and normal),
+		//instead of the plain bilinear filter that smears silhouettes over the background
+		void ToggleEdgeAwareUpscaling() { m_EdgeAwareUpscalingEnabled = !m_EdgeAwareUpscalingEnabled; m_LastViewState = {}; }
+		bool IsEdgeAwareUpscalingEnabled() const { return m_EdgeAwareUpscalingEnabled; }
 
 	private:
 		SDL_Window* m_pWindow{};
+		std::unique_ptr<Presenter> m_pPresenter{};
 
+		//Surface the current frame is traced into, the presenter's back buffer when there is a window
 		SDL_Surface* m_pBuffer{};
 		uint32_t* m_pBufferPixels{};
+		bool m_OwnsBuffer{ false };
+		//Format of m_pBuffer, looked up once
+		PixelPacker m_PixelPacker{};
 
 		int m_Width{};
 		int m_Height{};
 
+		//Internal render resolution, m_pRenderPixels points into the surface at full resolution and into m_ScaledPixels otherwise
+		int m_RenderWidth{};
+		int m_RenderHeight{};
+		uint32_t* m_pRenderPixels{};
+		std::vector<uint32_t> m_ScaledPixels{};
+		//Unclamped radiance at the render resolution, resolved into m_pRenderPixels every frame.
+		//Cache line aligned, so with a width that is a multiple of 16 every tile row covers whole cache lines
+		std::vector<ColorRGB, AlignedAllocator<ColorRGB>> m_HdrPixels{};
+		//Average of the accumulated frames, what gets resolved once there is more than one
+		std::vector<ColorRGB, AlignedAllocator<ColorRGB>> m_AccumulatedPixels{};
+		ToneMapper m_ToneMapper{};
+
+		DynamicResolution m_DynamicResolution{};
+		bool m_DynamicResolutionEnabled{ false };
+		float m_FixedRenderScale{ 1.f };
+		bool m_EdgeAwareUpscalingEnabled{ false };
+		//One flag per render pixel, set where the pixels it gets blended with while upscaling are on another surface
+		std::vector<uint8_t> m_UpscaleEdges{};
+
 		float m_XAddition{};
 		float m_YAddition{};
 
+		Scheduler m_Scheduler{};
+		static constexpr uint32_t m_TileSize{ 32 };
+
 		enum class LightingMode
 		{
 			ObservedArea, //Lambert Cosine Law
@@ -56,5 +213,162 @@ namespace dae
 
 		LightingMode m_CurrentLightingMode{ LightingMode::Combined };
 		bool m_ShadowsEnabled{ true };
+		bool m_UsePPTPixelMapping{ false };
+		bool m_NumaReplicationEnabled{ false };
+		//Trace every tile into a thread private buffer and commit it whole, instead of writing pixel by pixel into m_HdrPixels
+		bool m_UseTileBuffers{ true };
+
+		bool m_ProgressiveEnabled{ false };
+		float m_ProgressiveBudget{ 1.f / 30.f };
+		uint32_t m_NrProgressivePhases{ 0 };
+
+		//World position a pixel saw in the last checkerboard frame, invalid where it couldn't be traced or reprojected
+		struct ReprojectionSample
+		{
+			Vector3 position{};
+			bool isValid{ false };
+		};
+		bool m_CheckerboardEnabled{ false };
+		bool m_HasCheckerboardHistory{ false };
+		//Half traced this frame, the pixels with (x + y) % 2 == m_CheckerboardParity
+		uint32_t m_CheckerboardParity{ 0 };
+		//Checkerboard frames rendered for the current view, after two every pixel is traced
+		uint32_t m_NrCheckerboardFrames{ 0 };
+		std::vector<ColorRGB, AlignedAllocator<ColorRGB>> m_HistoryPixels{};
+		std::vector<ReprojectionSample> m_HistorySamples{};
+		std::vector<ReprojectionSample> m_CheckerboardSamples{};
+
+		bool m_AdaptiveSamplingEnabled{ false };
+
+		bool m_AccumulationEnabled{ false };
+		uint32_t m_NrAccumulatedFrames{ 0 };
+		static constexpr uint32_t m_MaxAccumulatedFrames{ 256 };
+		bool m_DirtyRegionsEnabled{ true };
+		//One flag per tile at the render resolution, TracePass skips the clear ones while m_TraceDirtyTilesOnly is set
+		std::vector<uint8_t> m_DirtyTiles{};
+		bool m_TraceDirtyTilesOnly{ false };
+		uint32_t m_NrRetracedTiles{ 0 };
+
+		//Primary hits of the last full resolution trace, sized to the render resolution on the first frame that needs it.
+		//Checkerboard rendering reads the traced half's hits from it as well
+		bool m_GBufferEnabled{ false };
+		std::vector<GBufferSample, AlignedAllocator<GBufferSample>> m_GBuffer{};
+
+		//Scene state of the last complete frame, compared against to find what moved
+		struct MeshState
+		{
+			uint32_t transformVersion{};
+			unsigned char materialIndex{};
+			TriangleCullMode cullMode{};
+			Vector3 minAABB{};
+			Vector3 maxAABB{};
+		};
+		std::vector<MeshState> m_LastMeshStates{};
+		uint64_t m_LastPrimitiveVersion{};
+
+		//Sub-pixel offset of the view rays in pixels, only non-zero while tracing an accumulation frame
+		float m_JitterX{};
+		float m_JitterY{};
+
+		//Everything that changes the rendered image, used to know when the previous frame can be reused
+		struct ViewState
+		{
+			Vector3 cameraOrigin{};
+			Vector3 cameraForward{};
+			float fov{};
+			uint64_t geometryVersion{};
+			LightingMode lightingMode{};
+			bool shadowsEnabled{};
+			uint64_t lightsHash{};
+			bool usePPTPixelMapping{};
+			int renderWidth{};
+			int renderHeight{};
+
+			bool IsEqual(const ViewState& other) const;
+			//Everything but the geometry: the pixels that don't see a moved object stay the same
+			bool IsEqualExceptGeometry(const ViewState& other) const;
+			//Same camera, geometry and pixel mapping: every pixel sees the same surface, only its shading may differ
+			bool HasSameSurfaces(const ViewState& other) const;
+		};
+		ViewState m_LastViewState{};
+		ViewState m_InFlightViewState{};
+
+		std::future<bool> m_FrameFuture{};
+		std::atomic<bool> m_CancelRequested{ false };
+		//At most one restart per presented frame: set by CancelFrame, moved into m_IsFrameRestart by the next BeginFrame
+		bool m_WasFrameCanceled{ false };
+		bool m_IsFrameRestart{ false };
+
+		//Screen region [x, endX) x [y, endY)
+		struct Tile
+		{
+			uint32_t x{};
+			uint32_t y{};
+			uint32_t endX{};
+			uint32_t endY{};
+		};
+
+		//Returns false if the frame got canceled
+		bool RenderFrame(Scene* pScene, const Camera& camera);
+		void RenderProgressive(Scene* pScene, const Camera& camera, const ViewState& viewState);
+		//Traces every step-th pixel (starting at offset) in both directions of every tile
+		void TracePass(Scene* pScene, const Camera& camera, uint32_t offsetX, uint32_t offsetY, uint32_t step);
+		void FillProgressiveGaps();
+		//Shades every pixel from the G-buffer into m_HdrPixels
+		void ShadePass(Scene* pScene);
+		bool UsesGBuffer() const { return m_GBufferEnabled || m_CheckerboardEnabled || m_AdaptiveSamplingEnabled || m_EdgeAwareUpscalingEnabled; }
+		void RenderCheckerboard(Scene* pScene, const Camera& camera, const ViewState& viewState);
+		//Fills the half that wasn't traced and records what every pixel saw for the next frame
+		void ReconstructCheckerboard(const Camera& camera, bool isFullFrame, bool isViewStatic);
+		void RenderAdaptive(Scene* pScene, const Camera& camera, const ViewState& viewState);
+		//True if the corners of the block at (x, y) saw the same object with a similar normal and color
+		bool IsAdaptiveBlockSmooth(uint32_t x, uint32_t y) const;
+		//Flags the tiles that changed since the last complete frame, false if the whole frame has to be retraced
+		bool FindDirtyTiles(Scene* pScene, const Camera& camera);
+		//Flags every tile the screen projection of the box touches, with shadows also everything behind it as seen from every light
+		//(up to the planes that hide what lies behind them). False if that projection isn't bounded, because it reaches behind the camera
+		bool MarkDirtyBounds(const Vector3& minAABB, const Vector3& maxAABB, const Camera& camera, const std::vector<Light>& lights, const std::vector<Plane>& planes);
+		void StoreSceneState(Scene* pScene);
+		//Traces one jittered frame and blends it into the accumulation buffer
+		void AccumulateFrame(Scene* pScene, const Camera& camera);
+		//Radiance that gets tone mapped: the accumulated average, or the last traced frame
+		const std::vector<ColorRGB, AlignedAllocator<ColorRGB>>& GetRadiance() const { return m_NrAccumulatedFrames > 0 ? m_AccumulatedPixels : m_HdrPixels; }
+		void ForEachTile(uint32_t width, uint32_t height, const std::function<void(const Tile&)>& tileTask);
+		//Tone maps and packs m_HdrPixels into the render target
+		void Resolve();
+		void Upscale();
+		//Upscale guided by the G-buffer
+		void UpscaleEdgeAware();
+		//Publishes the finished frame to the presenter and switches to the new back buffer
+		void Present();
+		//Last completely rendered frame, for screenshots and captures
+		const SDL_Surface* GetFinishedFrame() const;
+		void SetRenderScale(float scale);
+		ViewState GetViewState(Scene* pScene, const Camera& camera) const;
+		//Shades the closest hit along the view ray, returns the unclamped radiance
+		ColorRGB TraceViewRay(Scene* pScene, const Camera& camera, const Vector3& rayDirection, const std::vector<Light>& lights, const std::vector<Material*>& materials, GBufferSample* pGBufferSample = nullptr) const;
+		GBufferSample TracePrimaryHit(Scene* pScene, const Camera& camera, const Vector3& rayDirection) const;
+		ColorRGB ShadeSample(Scene* pScene, const GBufferSample& sample, const std::vector<Light>& lights, const std::vector<Material*>& materials) const;
+
+		//Turns off the modes that let a frame skip tracing (progressive, checkerboard, adaptive sampling) or trace something else
+		//(accumulation) while it exists, so every benchmark frame is one complete trace. The modes restart from scratch afterwards
+		class FullTraceScope final
+		{
+		public:
+			explicit FullTraceScope(Renderer& renderer);
+			~FullTraceScope();
+
+			FullTraceScope(const FullTraceScope&) = delete;
+			FullTraceScope(FullTraceScope&&) noexcept = delete;
+			FullTraceScope& operator=(const FullTraceScope&) = delete;
+			FullTraceScope& operator=(FullTraceScope&&) noexcept = delete;
+
+		private:
+			Renderer& m_Renderer;
+			bool m_WasProgressive{};
+			bool m_WasCheckerboard{};
+			bool m_WasAdaptiveSampling{};
+			bool m_WasAccumulating{};
+		};
 	};
 }
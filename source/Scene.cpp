@@ -1,9 +1,29 @@
 #include "Scene.h"
 #include "Utils.h"
 #include "Material.h"
+#include "Topology.h"
+#include "ThreadPool.h"
+#include "MeshCache.h"
+
+//Standard includes
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
 
 namespace dae {
 
+namespace
+{
+	template<typename T>
+	uint64_t HashValue(uint64_t hash, const T& value)
+	{
+		return Utils::HashBytes(hash, &value, sizeof(value));
+	}
+}
+
 #pragma region Base Scene
 	//Initialize Scene with Default Solid Color Material (RED)
 	Scene::Scene():
@@ -28,10 +48,17 @@ namespace dae {
 
 	void dae::Scene::GetClosestHit(const Ray& ray, HitRecord& closestHit) const
 	{
+		//Read from the local copy when the geometry is replicated per NUMA node
+		const NodeReplica* pReplica = GetCurrentNodeReplica();
+		const std::vector<Sphere>& spheres = pReplica ? pReplica->spheres : m_SphereGeometries;
+		const std::vector<Plane>& planes = pReplica ? pReplica->planes : m_PlaneGeometries;
+		const std::vector<TriangleMesh>& triangleMeshes = pReplica ? pReplica->triangleMeshes : m_TriangleMeshGeometries;
+
 		//Temporary value to pass to HitTest functions
 		HitRecord hitRecord{};
+		uint32_t objectIndex{ 0 };
 
-		for (auto& sphere : m_SphereGeometries)
+		for (auto& sphere : spheres)
 		{
 			//Perform Sphere HitTest
 			GeometryUtils::HitTest_Sphere(sphere, ray, hitRecord);
@@ -44,10 +71,12 @@ namespace dae {
 				closestHit.normal = hitRecord.normal;
 				closestHit.origin = hitRecord.origin;
 				closestHit.t = hitRecord.t;
+				closestHit.objectIndex = objectIndex;
 			}
+			++objectIndex;
 		}
 
-		for (auto& plane : m_PlaneGeometries)
+		for (auto& plane : planes)
 		{
 			//Perform Plane HitTest
 			GeometryUtils::HitTest_Plane(plane, ray, hitRecord);
@@ -60,10 +89,12 @@ namespace dae {
 				closestHit.normal = hitRecord.normal;
 				closestHit.origin = hitRecord.origin;
 				closestHit.t = hitRecord.t;
+				closestHit.objectIndex = objectIndex;
 			}
+			++objectIndex;
 		}
 
-		for (auto& triangleMesh : m_TriangleMeshGeometries)
+		for (auto& triangleMesh : triangleMeshes)
 		{
 			//Perform TriangleMesh HitTest
 			GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray, hitRecord);
@@ -76,25 +107,32 @@ namespace dae {
 				closestHit.normal = hitRecord.normal;
 				closestHit.origin = hitRecord.origin;
 				closestHit.t = hitRecord.t;
+				closestHit.objectIndex = objectIndex;
 			}
+			++objectIndex;
 		}
 	}
 
 	bool Scene::DoesHit(const Ray& ray) const
 	{
-		for (auto& sphere : m_SphereGeometries)
+		const NodeReplica* pReplica = GetCurrentNodeReplica();
+		const std::vector<Sphere>& spheres = pReplica ? pReplica->spheres : m_SphereGeometries;
+		const std::vector<Plane>& planes = pReplica ? pReplica->planes : m_PlaneGeometries;
+		const std::vector<TriangleMesh>& triangleMeshes = pReplica ? pReplica->triangleMeshes : m_TriangleMeshGeometries;
+
+		for (auto& sphere : spheres)
 		{
 			//Perform Sphere HitTest
 			if (GeometryUtils::HitTest_Sphere(sphere, ray)) return true;
 		}
 
-		for (auto& plane : m_PlaneGeometries)
+		for (auto& plane : planes)
 		{
 			//Perform Plane HitTest
 			if (GeometryUtils::HitTest_Plane(plane, ray)) return true;
 		}
 
-		for (auto& triangleMesh : m_TriangleMeshGeometries)
+		for (auto& triangleMesh : triangleMeshes)
 		{
 			//Perform TriangleMesh HitTest
 			if (GeometryUtils::HitTest_TriangleMesh(triangleMesh, ray)) return true;
@@ -103,6 +141,114 @@ namespace dae {
 		return false;
 	}
 
+	uint64_t Scene::GetGeometryVersion() const
+	{
+		//Mesh data only changes through UpdateTransforms, which bumps transformVersion
+		uint64_t version = HashValue(GetPrimitiveVersion(), m_Lights.size());
+		version = HashValue(version, m_TriangleMeshGeometries.size());
+		for (const TriangleMesh& mesh : m_TriangleMeshGeometries)
+		{
+			version = HashValue(version, mesh.transformVersion);
+			version = HashValue(version, mesh.materialIndex);
+			version = HashValue(version, mesh.cullMode);
+		}
+
+		return version;
+	}
+
+	uint64_t Scene::GetPrimitiveVersion() const
+	{
+		//Field by field, the padding bytes of the structs aren't initialized
+		uint64_t version = HashValue(Utils::HASH_BASIS, m_SphereGeometries.size());
+		for (const Sphere& sphere : m_SphereGeometries)
+		{
+			version = HashValue(version, sphere.origin);
+			version = HashValue(version, sphere.radius);
+			version = HashValue(version, sphere.materialIndex);
+		}
+
+		version = HashValue(version, m_PlaneGeometries.size());
+		for (const Plane& plane : m_PlaneGeometries)
+		{
+			version = HashValue(version, plane.origin);
+			version = HashValue(version, plane.normal);
+			version = HashValue(version, plane.materialIndex);
+		}
+
+		return version;
+	}
+
+#pragma region NUMA Replicas
+	void Scene::UpdateNodeReplicas(uint32_t nrNodes)
+	{
+		//Replicating only pays off when there is more than one node
+		if (nrNodes <= 1)
+		{
+			m_NodeReplicas.clear();
+			return;
+		}
+
+		if (m_NodeReplicas.size() != nrNodes)
+		{
+			m_NodeReplicas.clear();
+			for (uint32_t node{ 0 }; node < nrNodes; ++node)
+			{
+				m_NodeReplicas.push_back(std::make_unique<NodeReplica>());
+			}
+		}
+
+		//New frame, every replica has to be checked again
+		++m_ReplicaFrame;
+	}
+
+	void Scene::SyncNodeReplica(uint32_t node)
+	{
+		if (node >= m_NodeReplicas.size())
+			return;
+
+		NodeReplica& replica = *m_NodeReplicas[node];
+		if (replica.syncedFrame.load(std::memory_order_acquire) == m_ReplicaFrame)
+			return;
+
+		std::lock_guard lock{ replica.mutex };
+		if (replica.syncedFrame.load(std::memory_order_relaxed) == m_ReplicaFrame)
+			return;
+
+		//Memory is committed on the node of the thread that first touches it, so copying here keeps it local
+		//Planes and spheres are tiny, meshes only get copied again when their transforms changed.
+		//Geometry loaded through the mesh cache is shared rather than copied, so only the instance data becomes local
+		replica.planes = m_PlaneGeometries;
+		replica.spheres = m_SphereGeometries;
+
+		replica.triangleMeshes.resize(m_TriangleMeshGeometries.size());
+		replica.meshVersions.resize(m_TriangleMeshGeometries.size(), UINT32_MAX);
+		for (size_t i{ 0 }; i < m_TriangleMeshGeometries.size(); ++i)
+		{
+			const TriangleMesh& mesh = m_TriangleMeshGeometries[i];
+			if (replica.meshVersions[i] == mesh.transformVersion && replica.triangleMeshes[i].materialIndex == mesh.materialIndex
+				&& replica.triangleMeshes[i].cullMode == mesh.cullMode)
+				continue;
+
+			replica.triangleMeshes[i] = mesh;
+			replica.meshVersions[i] = mesh.transformVersion;
+		}
+
+		replica.syncedFrame.store(m_ReplicaFrame, std::memory_order_release);
+	}
+
+	const Scene::NodeReplica* Scene::GetCurrentNodeReplica() const
+	{
+		if (m_NodeReplicas.empty())
+			return nullptr;
+
+		const NodeReplica* pReplica = m_NodeReplicas[Topology::GetCurrentNode() % m_NodeReplicas.size()].get();
+		if (pReplica->syncedFrame.load(std::memory_order_acquire) != m_ReplicaFrame)
+			return nullptr;
+
+		return pReplica;
+	}
+#pragma endregion
+
 #pragma region Scene Helpers
 	Sphere* Scene::AddSphere(const Vector3& origin, float radius, unsigned char materialIndex)
 	{
@@ -136,6 +282,13 @@ namespace dae {
 		return &m_TriangleMeshGeometries.back();
 	}
 
+	TriangleMesh* Scene::AddTriangleMesh(const std::string& filename, TriangleCullMode cullMode, unsigned char materialIndex)
+	{
+		TriangleMesh* pMesh = AddTriangleMesh(cullMode, materialIndex);
+		pMesh->SetGeometry(MeshCache::Load(filename));
+		return pMesh;
+	}
+
 	Light* Scene::AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color)
 	{
 		Light l;
@@ -165,6 +318,77 @@ namespace dae {
 		m_Materials.push_back(pMaterial);
 		return static_cast<unsigned char>(m_Materials.size() - 1);
 	}
+
+	void Scene::AddTriangleMeshAsync(const std::string& filename, TriangleCullMode cullMode, unsigned char materialIndex,
+		std::function<void(TriangleMesh&)> prepare, std::function<void(TriangleMesh*)> onAdded)
+	{
+		//Loading gets its own (smaller) pool, long parse jobs would otherwise hold up the render tasks queued behind them
+		if (!m_pLoaderPool)
+			m_pLoaderPool = std::make_unique<ThreadPool>(std::max(std::thread::hardware_concurrency() / 2, 1u));
+
+		PendingMesh pending{};
+		pending.pMesh = std::make_unique<TriangleMesh>();
+		pending.pMesh->cullMode = cullMode;
+		pending.pMesh->materialIndex = materialIndex;
+		pending.onAdded = std::move(onAdded);
+
+		TriangleMesh* pMesh = pending.pMesh.get();
+		pending.future = m_pLoaderPool->Submit([pMesh, filename, prepare = std::move(prepare)]
+			{
+				std::shared_ptr<const MeshGeometry> pGeometry = MeshCache::Load(filename);
+				if (!pGeometry)
+					throw std::runtime_error("Could not load mesh '" + filename + "'");
+
+				pMesh->SetGeometry(std::move(pGeometry));
+
+				if (prepare)
+					prepare(*pMesh);
+			});
+
+		m_PendingMeshes.push_back(std::move(pending));
+	}
+
+	void Scene::WaitForLoading()
+	{
+		for (const PendingMesh& pending : m_PendingMeshes)
+		{
+			pending.future.wait();
+		}
+
+		AddLoadedMeshes();
+	}
+
+	void Scene::AddLoadedMeshes()
+	{
+		for (size_t i{ 0 }; i < m_PendingMeshes.size();)
+		{
+			PendingMesh& pending = m_PendingMeshes[i];
+			if (pending.future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			{
+				++i;
+				continue;
+			}
+
+			try
+			{
+				//Rethrows what the load threw
+				pending.future.get();
+
+				m_TriangleMeshGeometries.emplace_back(std::move(*pending.pMesh));
+				if (pending.onAdded)
+					pending.onAdded(&m_TriangleMeshGeometries.back());
+			}
+			catch (const std::exception& exception)
+			{
+				std::cout << exception.what() << std::endl;
+				++m_NrFailedLoads;
+			}
+
+			//Order doesn't matter, swap with the last one
+			pending = std::move(m_PendingMeshes.back());
+			m_PendingMeshes.pop_back();
+		}
+	}
 #pragma endregion
 #pragma endregion
 
@@ -327,9 +551,9 @@ namespace dae {
 		AddPointLight({ -2.5f,	5.f,	-5.f }, 70.f, ColorRGB{ 1.f, 0.8f, 0.45f }); //Front Light Left
 		AddPointLight({ 2.5f,	2.5f,	-5.f }, 50.f, ColorRGB{ 0.34f, 0.47f, 0.68f });
 	}
-	void Scene_W4_TestScene::Update(Timer* pTimer)
+	void Scene_W4_TestScene::UpdateScene(Timer* pTimer)
 	{
-		Scene::Update(pTimer);
+		Scene::UpdateScene(pTimer);
 
 		pMesh->RotateY(PI_DIV_2 * pTimer->GetTotal());
 		pMesh->UpdateTransforms();
@@ -394,9 +618,9 @@ namespace dae {
 		AddPointLight({ -2.5f,	5.f,	-5.f }, 70.f, ColorRGB{ 1.f, 0.8f, 0.45f }); //Front Light Left
 		AddPointLight({ 2.5f,	2.5f,	-5.f }, 50.f, ColorRGB{ 0.34f, 0.47f, 0.68f });
 	}
-	void Scene_W4_ReferenceScene::Update(Timer* pTimer)
+	void Scene_W4_ReferenceScene::UpdateScene(Timer* pTimer)
 	{
-		Scene::Update(pTimer);
+		Scene::UpdateScene(pTimer);
 
 		const auto yawAngle = (cos(pTimer->GetTotal()) + 1.f) / 2.f * PI_2;
 		for (const auto m : m_Meshes)
@@ -425,11 +649,7 @@ namespace dae {
 		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, matLambert_GrayBlue); //LEFT
 
 		//Triangle Mesh
-		m_pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matLambert_White);
-		Utils::ParseOBJ("Resources/lowpoly_bunny2.obj",
-			m_pMesh->positions,
-			m_pMesh->normals,
-			m_pMesh->indices);
+		m_pMesh = AddTriangleMesh("Resources/lowpoly_bunny2.obj", TriangleCullMode::BackFaceCulling, matLambert_White);
 
 		m_pMesh->Scale({ 2.f, 2.f, 2.f });
 
@@ -441,9 +661,9 @@ namespace dae {
 		AddPointLight({ -2.5f,	5.f,	-5.f }, 70.f, ColorRGB{ 1.f, 0.8f, 0.45f }); //Front Light Left
 		AddPointLight({ 2.5f,	2.5f,	-5.f }, 50.f, ColorRGB{ 0.34f, 0.47f, 0.68f });
 	}
-	void dae::Scene_W4_BunnyScene::Update(Timer* pTimer)
+	void dae::Scene_W4_BunnyScene::UpdateScene(Timer* pTimer)
 	{
-		Scene::Update(pTimer);
+		Scene::UpdateScene(pTimer);
 
 		const auto yawAngle = (cos(pTimer->GetTotal()) + 1.f) / 2.f * PI_2;
 
@@ -470,27 +690,30 @@ namespace dae {
 		AddPlane({ 5.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, matLambert_GrayBlue); //RIGHT
 		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, matLambert_GrayBlue); //LEFT
 
-		//Triangle Mesh
-		m_pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matCT_GrayMediumMetal);
-		Utils::ParseOBJ("Resources/RubiksCube2.obj",
-			m_pMesh->positions,
-			m_pMesh->normals,
-			m_pMesh->indices);
+		//Triangle Mesh (loaded in the background)
+		AddTriangleMeshAsync("Resources/RubiksCube2.obj", TriangleCullMode::BackFaceCulling, matCT_GrayMediumMetal,
+			[](TriangleMesh& mesh)
+			{
+				mesh.Scale({ 0.01f, 0.01f, 0.01f });
+				mesh.Translate({ 0, 3, 0 });
 
-		m_pMesh->Scale({ 0.01f, 0.01f, 0.01f });
-		m_pMesh->Translate({ 0, 3, 0 });
-
-		m_pMesh->UpdateAABB();
-		m_pMesh->UpdateTransforms();
+				mesh.UpdateAABB();
+				mesh.UpdateTransforms();
+			},
+			[this](TriangleMesh* pMesh) { m_pMesh = pMesh; });
 
 		//Lights
 		AddPointLight({ 0.f,	5.f,	5.f }, 50.f, ColorRGB{ 1.f, 0.61f, 0.45f }); //Backlight
 		AddPointLight({ -2.5f,	5.f,	-5.f }, 70.f, ColorRGB{ 1.f, 0.8f, 0.45f }); //Front Light Left
 		AddPointLight({ 2.5f,	2.5f,	-5.f }, 50.f, ColorRGB{ 0.34f, 0.47f, 0.68f });
 	}
-	void Scene_TestExtra::Update(Timer* pTimer)
+	void Scene_TestExtra::UpdateScene(Timer* pTimer)
 	{
-		Scene::Update(pTimer);
+		Scene::UpdateScene(pTimer);
+
+		//Still loading
+		if (!m_pMesh)
+			return;
 
 		const auto yawAngle = (cos(pTimer->GetTotal() / 10.f) + 1.f) / 2.f * PI_2;
 
@@ -517,56 +740,33 @@ namespace dae {
 		AddPlane({ 5.f, 0.f, 0.f }, { -1.f, 0.f, 0.f }, matLambert_GrayBlue); //RIGHT
 		AddPlane({ -5.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, matLambert_GrayBlue); //LEFT
 
-		//Triangle Mesh
+		//Triangle Mesh (all pieces are loaded in the background and show up as soon as they are ready)
 		const unsigned char matId_RubiksCube = matCT_GrayMediumMetal;
+		const auto prepareMesh = [](TriangleMesh& mesh)
+			{
+				mesh.Scale({ 0.01f, 0.01f, 0.01f });
+				mesh.Translate({ 0, 3, 0 });
+
+				mesh.UpdateAABB();
+				mesh.UpdateTransforms();
+			};
+		const auto onMeshAdded = [this](TriangleMesh* pMesh) { m_Meshes.push_back(pMesh); };
+
 		int nrCorners{ 8 }, nrSides{ 12 }, nrMiddles{ 6 };
 		for (int i{ 0 }; i < nrCorners; ++i)
 		{
-			TriangleMesh* pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matId_RubiksCube);
-			Utils::ParseOBJ("Resources/RubiksCubeCorner" + std::to_string(i + 1) + ".obj",
-				pMesh->positions,
-				pMesh->normals,
-				pMesh->indices);
-
-			pMesh->Scale({ 0.01f, 0.01f, 0.01f });
-			pMesh->Translate({ 0, 3, 0 });
-
-			pMesh->UpdateAABB();
-			pMesh->UpdateTransforms();
-
-			m_Meshes.push_back(pMesh);
+			AddTriangleMeshAsync("Resources/RubiksCubeCorner" + std::to_string(i + 1) + ".obj",
+				TriangleCullMode::BackFaceCulling, matId_RubiksCube, prepareMesh, onMeshAdded);
 		}
 		for (int i{ 0 }; i < nrSides; ++i)
 		{
-			TriangleMesh* pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matId_RubiksCube);
-			Utils::ParseOBJ("Resources/RubiksCubeSide" + std::to_string(i + 1) + ".obj",
-				pMesh->positions,
-				pMesh->normals,
-				pMesh->indices);
-
-			pMesh->Scale({ 0.01f, 0.01f, 0.01f });
-			pMesh->Translate({ 0, 3, 0 });
-
-			pMesh->UpdateAABB();
-			pMesh->UpdateTransforms();
-
-			m_Meshes.push_back(pMesh);
+			AddTriangleMeshAsync("Resources/RubiksCubeSide" + std::to_string(i + 1) + ".obj",
+				TriangleCullMode::BackFaceCulling, matId_RubiksCube, prepareMesh, onMeshAdded);
 		}
 		for (int i{ 0 }; i < nrMiddles; ++i)
 		{
-			TriangleMesh* pMesh = AddTriangleMesh(TriangleCullMode::BackFaceCulling, matId_RubiksCube);
-			Utils::ParseOBJ("Resources/RubiksCubeMiddle" + std::to_string(i + 1) + ".obj",
-				pMesh->positions,
-				pMesh->normals,
-				pMesh->indices);
-
-			pMesh->Scale({ 0.01f, 0.01f, 0.01f });
-			pMesh->Translate({ 0, 3, 0 });
-
-			pMesh->UpdateAABB();
-			pMesh->UpdateTransforms();
-
-			m_Meshes.push_back(pMesh);
+			AddTriangleMeshAsync("Resources/RubiksCubeMiddle" + std::to_string(i + 1) + ".obj",
+				TriangleCullMode::BackFaceCulling, matId_RubiksCube, prepareMesh, onMeshAdded);
 		}
 
 		//Lights
@@ -574,9 +774,9 @@ namespace dae {
 		AddPointLight({ -2.5f,	5.f,	-5.f }, 70.f, ColorRGB{ 1.f, 0.8f, 0.45f }); //Front Light Left
 		AddPointLight({ 2.5f,	2.5f,	-5.f }, 50.f, ColorRGB{ 0.34f, 0.47f, 0.68f });
 	}
-	void Scene_Extra::Update(Timer* pTimer)
+	void Scene_Extra::UpdateScene(Timer* pTimer)
 	{
-		Scene::Update(pTimer);
+		Scene::UpdateScene(pTimer);
 
 		const auto angle = (cos(pTimer->GetTotal() / 5.f) + 1.f) / 2.f * PI_2;
 		for (const auto m : m_Meshes)
@@ -585,5 +785,212 @@ namespace dae {
 			m->UpdateTransforms();
 		}
 	}
+
+	Scene_File::Scene_File(const std::string& filename) :
+		m_Filename(filename)
+	{
+	}
+
+	void Scene_File::Initialize()
+	{
+		sceneName = m_Filename;
+
+		std::ifstream file{ m_Filename };
+		if (!file)
+		{
+			std::cout << "Could not open scene file '" << m_Filename << "'" << std::endl;
+			return;
+		}
+
+		const std::filesystem::path directory = std::filesystem::path{ m_Filename }.parent_path();
+		std::unordered_map<std::string, unsigned char> materials{};
+
+		std::string line{};
+		int lineNumber{ 0 };
+		while (std::getline(file, line))
+		{
+			++lineNumber;
+
+			const size_t commentStart = line.find('#');
+			if (commentStart != std::string::npos)
+				line.erase(commentStart);
+
+			std::istringstream stream{ line };
+			std::string command{};
+			if (!(stream >> command))
+				continue;
+
+			const auto readVector = [&stream](Vector3& v) { return static_cast<bool>(stream >> v.x >> v.y >> v.z); };
+			const auto readColor = [&stream](ColorRGB& c) { return static_cast<bool>(stream >> c.r >> c.g >> c.b); };
+			const auto readMaterial = [&stream, &materials](unsigned char& materialIndex)
+				{
+					std::string name{};
+					if (!(stream >> name))
+						return false;
+
+					const auto it = materials.find(name);
+					if (it == materials.end())
+						return false;
+
+					materialIndex = it->second;
+					return true;
+				};
+
+			bool isValid{ true };
+			if (command == "camera")
+			{
+				Vector3 origin{};
+				float fovAngle{};
+				isValid = readVector(origin) && static_cast<bool>(stream >> fovAngle);
+				if (isValid)
+				{
+					m_Camera.origin = origin;
+					m_Camera.fovAngle = fovAngle;
+					m_Camera.fov = tanf(m_Camera.fovAngle / 2.f * TO_RADIANS);
+
+					float pitch{}, yaw{};
+					if (stream >> pitch >> yaw)
+					{
+						m_Camera.totalPitch = pitch * TO_RADIANS;
+						m_Camera.totalYaw = yaw * TO_RADIANS;
+					}
+				}
+			}
+			else if (command == "material")
+			{
+				std::string name{}, type{};
+				ColorRGB color{};
+				isValid = static_cast<bool>(stream >> name >> type) && readColor(color) && m_Materials.size() < 256;
+
+				Material* pMaterial{ nullptr };
+				if (isValid && type == "solid")
+				{
+					pMaterial = new Material_SolidColor(color);
+				}
+				else if (isValid && type == "lambert")
+				{
+					float kd{};
+					if (stream >> kd)
+						pMaterial = new Material_Lambert(color, kd);
+				}
+				else if (isValid && type == "phong")
+				{
+					float kd{}, ks{}, exponent{};
+					if (stream >> kd >> ks >> exponent)
+						pMaterial = new Material_LambertPhong(color, kd, ks, exponent);
+				}
+				else if (isValid && type == "cooktorrance")
+				{
+					float metalness{}, roughness{};
+					if (stream >> metalness >> roughness)
+						pMaterial = new Material_CookTorrence(color, metalness, roughness);
+				}
+
+				isValid = pMaterial != nullptr;
+				if (isValid)
+					materials[name] = AddMaterial(pMaterial);
+			}
+			else if (command == "sphere")
+			{
+				Vector3 origin{};
+				float radius{};
+				unsigned char materialIndex{};
+				isValid = readVector(origin) && static_cast<bool>(stream >> radius) && readMaterial(materialIndex);
+				if (isValid)
+					AddSphere(origin, radius, materialIndex);
+			}
+			else if (command == "plane")
+			{
+				Vector3 origin{}, normal{};
+				unsigned char materialIndex{};
+				isValid = readVector(origin) && readVector(normal) && readMaterial(materialIndex);
+				if (isValid)
+					AddPlane(origin, normal.Normalized(), materialIndex);
+			}
+			else if (command == "mesh")
+			{
+				std::string path{};
+				unsigned char materialIndex{};
+				isValid = static_cast<bool>(stream >> path) && readMaterial(materialIndex);
+
+				TriangleCullMode cullMode{ TriangleCullMode::BackFaceCulling };
+				Vector3 translation{}, scale{ 1.f, 1.f, 1.f };
+				float pitch{}, yaw{};
+
+				std::string option{};
+				while (isValid && stream >> option)
+				{
+					if (option == "cull")
+					{
+						std::string mode{};
+						stream >> mode;
+						if (mode == "back")
+							cullMode = TriangleCullMode::BackFaceCulling;
+						else if (mode == "front")
+							cullMode = TriangleCullMode::FrontFaceCulling;
+						else if (mode == "none")
+							cullMode = TriangleCullMode::NoCulling;
+						else
+							isValid = false;
+					}
+					else if (option == "translate")
+						isValid = readVector(translation);
+					else if (option == "rotate")
+						isValid = static_cast<bool>(stream >> pitch >> yaw);
+					else if (option == "scale")
+						isValid = readVector(scale);
+					else
+						isValid = false;
+				}
+
+				if (isValid)
+				{
+					//Every mesh is parsed (or mapped from its cache) on the loader threads, all at the same time.
+					//A file that is there but can't be parsed only shows up once its load is done (GetNrFailedLoads)
+					const std::string meshFilename = (directory / path).string();
+					std::error_code error{};
+					if (!std::filesystem::is_regular_file(meshFilename, error))
+					{
+						std::cout << m_Filename << "(" << lineNumber << "): mesh '" << meshFilename << "' not found" << std::endl;
+						return;
+					}
+
+					AddTriangleMeshAsync(meshFilename, cullMode, materialIndex,
+						[translation, scale, pitch, yaw](TriangleMesh& mesh)
+						{
+							mesh.Scale(scale);
+							mesh.RotateXY(pitch * TO_RADIANS, yaw * TO_RADIANS);
+							mesh.Translate(translation);
+
+							mesh.UpdateAABB();
+							mesh.UpdateTransforms();
+						});
+				}
+			}
+			else if (command == "pointlight" || command == "directionallight")
+			{
+				Vector3 vector{};
+				float intensity{};
+				ColorRGB color{};
+				isValid = readVector(vector) && static_cast<bool>(stream >> intensity) && readColor(color);
+				if (isValid && command == "pointlight")
+					AddPointLight(vector, intensity, color);
+				else if (isValid)
+					AddDirectionalLight(vector.Normalized(), intensity, color);
+			}
+			else
+			{
+				isValid = false;
+			}
+
+			if (!isValid)
+			{
+				std::cout << m_Filename << "(" << lineNumber << "): invalid '" << command << "' declaration" << std::endl;
+				return;
+			}
+		}
+
+		m_IsLoaded = true;
+	}
 #pragma endregion
 }
@@ -1,4 +1,9 @@
 #pragma once
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -10,6 +15,7 @@ namespace dae
 {
 	//Forward Declarations
 	class Timer;
+	class ThreadPool;
 	class Material;
 	struct Plane;
 	struct Sphere;
@@ -28,10 +34,15 @@ namespace dae
 		Scene& operator=(Scene&&) noexcept = delete;
 
 		virtual void Initialize() = 0;
-		virtual void Update(dae::Timer* pTimer)
+		//Camera input followed by UpdateScene, once per frame
+		void Update(dae::Timer* pTimer)
 		{
-			m_Camera.Update(pTimer);
+			UpdateCamera(pTimer);
+			UpdateScene(pTimer);
 		}
+		void UpdateCamera(dae::Timer* pTimer) { m_Camera.Update(pTimer); }
+		//Everything but the camera: adds loaded meshes and advances animations. Never call this while a frame is being traced
+		virtual void UpdateScene(dae::Timer* pTimer) { AddLoadedMeshes(); }
 
 		Camera& GetCamera() { return m_Camera; }
 		void GetClosestHit(const Ray& ray, HitRecord& closestHit) const;
@@ -39,9 +50,28 @@ namespace dae
 
 		const std::vector<Plane>& GetPlaneGeometries() const { return m_PlaneGeometries; }
 		const std::vector<Sphere>& GetSphereGeometries() const { return m_SphereGeometries; }
+		const std::vector<TriangleMesh>& GetTriangleMeshGeometries() const { return m_TriangleMeshGeometries; }
 		const std::vector<Light>& GetLights() const { return m_Lights; }
 		const std::vector<Material*> GetMaterials() const { return m_Materials; }
 
+		//Changes whenever geometry or lights are added, a mesh transform is updated or any sphere, plane or mesh material changes.
+		//Materials themselves must not change after they are added
+		uint64_t GetGeometryVersion() const;
+		//Hash of every sphere and plane, scenes can change those at any time through the pointers AddSphere/AddPlane return
+		uint64_t GetPrimitiveVersion() const;
+
+		//Called once per frame before rendering: keeps one copy of the traced geometry per NUMA node (0 or 1 node releases them)
+		void UpdateNodeReplicas(uint32_t nrNodes);
+		//Copies the geometry that changed since the last frame, must be called from a thread running on that node
+		void SyncNodeReplica(uint32_t node);
+
+		//True while meshes are still being loaded in the background
+		bool IsLoading() const { return !m_PendingMeshes.empty(); }
+		//Blocks until every background load is done and adds the meshes
+		void WaitForLoading();
+		//Background loads that failed so far (each is printed), those meshes are left out of the scene
+		uint32_t GetNrFailedLoads() const { return m_NrFailedLoads; }
+
 	protected:
 		std::string	sceneName;
 
@@ -56,10 +86,49 @@ namespace dae
 		Sphere* AddSphere(const Vector3& origin, float radius, unsigned char materialIndex = 0);
 		Plane* AddPlane(const Vector3& origin, const Vector3& normal, unsigned char materialIndex = 0);
 		TriangleMesh* AddTriangleMesh(TriangleCullMode cullMode, unsigned char materialIndex = 0);
+		//Loads the OBJ through the mesh cache, meshes of the same file share one copy of its geometry and only own their transform and material
+		TriangleMesh* AddTriangleMesh(const std::string& filename, TriangleCullMode cullMode, unsigned char materialIndex = 0);
 
 		Light* AddPointLight(const Vector3& origin, float intensity, const ColorRGB& color);
 		Light* AddDirectionalLight(const Vector3& direction, float intensity, const ColorRGB& color);
 		unsigned char AddMaterial(Material* pMaterial);
+
+		//Loads the OBJ (shared like above) on a loader thread, prepare runs right after on that same thread (transforms, AABB, ...)
+		//The finished mesh is added to the scene by the first Update after it's done, onAdded receives its final address
+		void AddTriangleMeshAsync(const std::string& filename, TriangleCullMode cullMode, unsigned char materialIndex,
+			std::function<void(TriangleMesh&)> prepare, std::function<void(TriangleMesh*)> onAdded = {});
+		//Moves all finished meshes into the scene, only call this while no frame is being rendered
+		void AddLoadedMeshes();
+
+	private:
+		struct PendingMesh
+		{
+			std::future<void> future{};
+			std::unique_ptr<TriangleMesh> pMesh{};
+			std::function<void(TriangleMesh*)> onAdded{};
+		};
+
+		//Declared before the pool so the pool (and with it every running load) is gone before the meshes it writes to
+		std::vector<PendingMesh> m_PendingMeshes{};
+		std::unique_ptr<ThreadPool> m_pLoaderPool{};
+		uint32_t m_NrFailedLoads{};
+
+		struct NodeReplica
+		{
+			std::mutex mutex{};
+			std::atomic<uint32_t> syncedFrame{ 0 };
+
+			std::vector<Plane> planes{};
+			std::vector<Sphere> spheres{};
+			std::vector<TriangleMesh> triangleMeshes{};
+			std::vector<uint32_t> meshVersions{};
+		};
+
+		std::vector<std::unique_ptr<NodeReplica>> m_NodeReplicas{};
+		uint32_t m_ReplicaFrame{ 0 };
+
+		//Replica of the calling thread's node, nullptr if there is none or it isn't synced for this frame
+		const NodeReplica* GetCurrentNodeReplica() const;
 	};
 
 	//+++++++++++++++++++++++++++++++++++++++++
@@ -140,7 +209,7 @@ namespace dae
 		Scene_W4_TestScene& operator=(Scene_W4_TestScene&&) noexcept = delete;
 
 		void Initialize() override;
-		void Update(Timer* pTimer) override;
+		void UpdateScene(Timer* pTimer) override;
 
 	private:
 		TriangleMesh* pMesh{ nullptr };
@@ -160,7 +229,7 @@ namespace dae
 		Scene_W4_ReferenceScene& operator=(Scene_W4_ReferenceScene&&) noexcept = delete;
 
 		void Initialize() override;
-		void Update(Timer* pTimer) override;
+		void UpdateScene(Timer* pTimer) override;
 
 	private:
 		TriangleMesh* m_Meshes[3]{};
@@ -180,7 +249,7 @@ namespace dae
 		Scene_W4_BunnyScene& operator=(Scene_W4_BunnyScene&&) noexcept = delete;
 
 		void Initialize() override;
-		void Update(Timer* pTimer) override;
+		void UpdateScene(Timer* pTimer) override;
 
 	private:
 		TriangleMesh* m_pMesh{ nullptr };
@@ -200,7 +269,7 @@ namespace dae
 		Scene_TestExtra& operator=(Scene_TestExtra&&) noexcept = delete;
 
 		void Initialize() override;
-		void Update(Timer* pTimer) override;
+		void UpdateScene(Timer* pTimer) override;
 
 	private:
 		TriangleMesh* m_pMesh{ nullptr };
@@ -220,9 +289,44 @@ namespace dae
 		Scene_Extra& operator=(Scene_Extra&&) noexcept = delete;
 
 		void Initialize() override;
-		void Update(Timer* pTimer) override;
+		void UpdateScene(Timer* pTimer) override;
 
 	private:
 		std::vector<TriangleMesh*> m_Meshes{};
 	};
+
+	//+++++++++++++++++++++++++++++++++++++++++
+	//Scene described by a text file, one declaration per line ('#' starts a comment):
+	//	camera <x y z> <fov> [<pitch> <yaw>]
+	//	material <name> solid <r g b>
+	//	material <name> lambert <r g b> <kd>
+	//	material <name> phong <r g b> <kd> <ks> <exponent>
+	//	material <name> cooktorrance <r g b> <metalness> <roughness>
+	//	sphere <x y z> <radius> <material>
+	//	plane <x y z> <nx ny nz> <material>
+	//	mesh <file.obj> <material> [cull <back|front|none>] [translate <x y z>] [rotate <pitch> <yaw>] [scale <x y z>]
+	//	pointlight <x y z> <intensity> <r g b>
+	//	directionallight <x y z> <intensity> <r g b>
+	//Angles are in degrees, mesh paths are relative to the scene file. Meshes are loaded in the background
+	class Scene_File final : public Scene
+	{
+	public:
+		explicit Scene_File(const std::string& filename);
+		~Scene_File() override = default;
+
+		Scene_File(const Scene_File&) = delete;
+		Scene_File(Scene_File&&) noexcept = delete;
+		Scene_File& operator=(const Scene_File&) = delete;
+		Scene_File& operator=(Scene_File&&) noexcept = delete;
+
+		void Initialize() override;
+
+		//False if the file couldn't be read or contains errors (these are printed), the scene then holds everything up to the error.
+		//Also false once one of its meshes failed to load in the background
+		bool IsLoaded() const { return m_IsLoaded && GetNrFailedLoads() == 0; }
+
+	private:
+		std::string m_Filename{};
+		bool m_IsLoaded{ false };
+	};
 }
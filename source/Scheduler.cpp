@@ -0,0 +1,290 @@
+#include "Scheduler.h"
+
+//Standard includes
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <ppl.h> //parallel_for
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+using namespace dae;
+
+Scheduler::Scheduler() :
+	m_pThreadPool(std::make_unique<ThreadPool>())
+{
+}
+
+void Scheduler::Run(uint32_t nrTasks, const std::function<void(uint32_t)>& task)
+{
+	if (nrTasks == 0)
+		return;
+
+	switch (m_Mode)
+	{
+	case SchedulerMode::Serial:
+		RunSerial(nrTasks, task);
+		break;
+
+	case SchedulerMode::StaticPartition:
+		RunStaticPartition(nrTasks, task);
+		break;
+
+	case SchedulerMode::DynamicChunked:
+		RunDynamicChunked(nrTasks, task);
+		break;
+
+	case SchedulerMode::WorkStealing:
+		RunWorkStealing(nrTasks, task);
+		break;
+
+	case SchedulerMode::ParallelFor:
+		RunParallelFor(nrTasks, task);
+		break;
+
+	case SchedulerMode::OpenMP:
+		RunOpenMP(nrTasks, task);
+		break;
+
+	default:
+		RunSerial(nrTasks, task);
+		break;
+	}
+}
+
+void Scheduler::SetMode(SchedulerMode mode)
+{
+	if (IsModeAvailable(mode))
+		m_Mode = mode;
+}
+
+void Scheduler::CycleMode()
+{
+	//Skip backends that aren't compiled in
+	SchedulerMode mode{ m_Mode };
+	do
+	{
+		mode = SchedulerMode(((int)mode + 1) % (int)SchedulerMode::End);
+	} while (!IsModeAvailable(mode));
+
+	m_Mode = mode;
+}
+
+void Scheduler::SetNrWorkers(uint32_t nrWorkers)
+{
+	if (nrWorkers == 0 || nrWorkers == m_pThreadPool->GetNrWorkers())
+		return;
+
+	const bool areWorkersPinned = m_pThreadPool->AreWorkersPinned();
+	m_pThreadPool.reset();
+	m_pThreadPool = std::make_unique<ThreadPool>(nrWorkers, areWorkersPinned);
+}
+
+void Scheduler::SetWorkerPinning(bool pinWorkers)
+{
+	if (pinWorkers == m_pThreadPool->AreWorkersPinned())
+		return;
+
+	const uint32_t nrWorkers = m_pThreadPool->GetNrWorkers();
+	m_pThreadPool.reset();
+	m_pThreadPool = std::make_unique<ThreadPool>(nrWorkers, pinWorkers);
+}
+
+bool Scheduler::IsModeAvailable(SchedulerMode mode)
+{
+	switch (mode)
+	{
+	case SchedulerMode::OpenMP:
+	#if defined(_OPENMP)
+		return true;
+	#else
+		return false;
+	#endif
+
+	case SchedulerMode::End:
+		return false;
+
+	default:
+		return true;
+	}
+}
+
+const char* Scheduler::GetModeName(SchedulerMode mode)
+{
+	switch (mode)
+	{
+	case SchedulerMode::Serial:				return "serial";
+	case SchedulerMode::StaticPartition:	return "static";
+	case SchedulerMode::DynamicChunked:		return "dynamic";
+	case SchedulerMode::WorkStealing:		return "workstealing";
+	case SchedulerMode::ParallelFor:		return "parallelfor";
+	case SchedulerMode::OpenMP:				return "openmp";
+	default:								return "unknown";
+	}
+}
+
+bool Scheduler::TryParseMode(const std::string& name, SchedulerMode& mode)
+{
+	for (int i{ 0 }; i < (int)SchedulerMode::End; ++i)
+	{
+		if (name == GetModeName(SchedulerMode(i)))
+		{
+			mode = SchedulerMode(i);
+			return IsModeAvailable(mode);
+		}
+	}
+
+	return false;
+}
+
+void Scheduler::RunSerial(uint32_t nrTasks, const std::function<void(uint32_t)>& task)
+{
+	//Synchronous Logic (no threading)
+	for (uint32_t i{ 0 }; i < nrTasks; ++i)
+	{
+		task(i);
+	}
+}
+
+void Scheduler::RunStaticPartition(uint32_t nrTasks, const std::function<void(uint32_t)>& task)
+{
+	const uint32_t nrSlots = std::min(GetNrWorkers(), nrTasks);
+	const uint32_t nrTasksPerSlot = nrTasks / nrSlots;
+	const uint32_t nrUnassignedTasks = nrTasks % nrSlots;
+
+	m_pThreadPool->RunSlots(nrSlots, [&](uint32_t slot)
+		{
+			//The first nrUnassignedTasks slots get one extra task
+			const uint32_t taskBegin = slot * nrTasksPerSlot + std::min(slot, nrUnassignedTasks);
+			const uint32_t taskEnd = taskBegin + nrTasksPerSlot + (slot < nrUnassignedTasks ? 1 : 0);
+
+			for (uint32_t i{ taskBegin }; i < taskEnd; ++i)
+			{
+				task(i);
+			}
+		});
+}
+
+void Scheduler::RunDynamicChunked(uint32_t nrTasks, const std::function<void(uint32_t)>& task)
+{
+	std::atomic<uint32_t> nextTask{ 0 };
+
+	m_pThreadPool->RunSlots(GetNrWorkers(), [&](uint32_t)
+		{
+			while (true)
+			{
+				const uint32_t taskBegin = nextTask.fetch_add(m_ChunkSize, std::memory_order_relaxed);
+				if (taskBegin >= nrTasks)
+					return;
+
+				const uint32_t taskEnd = std::min(taskBegin + m_ChunkSize, nrTasks);
+				for (uint32_t i{ taskBegin }; i < taskEnd; ++i)
+				{
+					task(i);
+				}
+			}
+		});
+}
+
+void Scheduler::RunWorkStealing(uint32_t nrTasks, const std::function<void(uint32_t)>& task)
+{
+	//Remaining [begin, end) range of a slot, the owner takes from the front, thieves take from the back
+	struct alignas(64) TaskRange
+	{
+		std::mutex mutex{};
+		uint32_t begin{};
+		uint32_t end{};
+	};
+
+	const uint32_t nrSlots = std::min(GetNrWorkers(), nrTasks);
+	std::vector<TaskRange> ranges(nrSlots);
+
+	//Start from the same distribution as the static partition
+	const uint32_t nrTasksPerSlot = nrTasks / nrSlots;
+	const uint32_t nrUnassignedTasks = nrTasks % nrSlots;
+	for (uint32_t slot{ 0 }; slot < nrSlots; ++slot)
+	{
+		ranges[slot].begin = slot * nrTasksPerSlot + std::min(slot, nrUnassignedTasks);
+		ranges[slot].end = ranges[slot].begin + nrTasksPerSlot + (slot < nrUnassignedTasks ? 1 : 0);
+	}
+
+	m_pThreadPool->RunSlots(nrSlots, [&](uint32_t slot)
+		{
+			TaskRange& ownRange = ranges[slot];
+
+			while (true)
+			{
+				//Pop from own range
+				uint32_t taskIndex{};
+				bool hasTask{ false };
+				{
+					std::lock_guard lock{ ownRange.mutex };
+					if (ownRange.begin < ownRange.end)
+					{
+						taskIndex = ownRange.begin++;
+						hasTask = true;
+					}
+				}
+
+				if (hasTask)
+				{
+					task(taskIndex);
+					continue;
+				}
+
+				//Own range is empty, steal the back half of the first victim that still has work
+				bool didSteal{ false };
+				for (uint32_t offset{ 1 }; offset < nrSlots && !didSteal; ++offset)
+				{
+					TaskRange& victimRange = ranges[(slot + offset) % nrSlots];
+
+					uint32_t stolenBegin{}, stolenEnd{};
+					{
+						std::lock_guard lock{ victimRange.mutex };
+						const uint32_t nrRemaining = victimRange.end - victimRange.begin;
+						if (nrRemaining == 0)
+							continue;
+
+						stolenEnd = victimRange.end;
+						stolenBegin = stolenEnd - (nrRemaining + 1) / 2;
+						victimRange.end = stolenBegin;
+					}
+
+					std::lock_guard lock{ ownRange.mutex };
+					ownRange.begin = stolenBegin;
+					ownRange.end = stolenEnd;
+					didSteal = true;
+				}
+
+				//Nothing left anywhere
+				if (!didSteal)
+					return;
+			}
+		});
+}
+
+void Scheduler::RunParallelFor(uint32_t nrTasks, const std::function<void(uint32_t)>& task)
+{
+	//Parellel-For Logic
+	concurrency::parallel_for(0u, nrTasks, [&](uint32_t i)
+		{
+			task(i);
+		});
+}
+
+void Scheduler::RunOpenMP(uint32_t nrTasks, const std::function<void(uint32_t)>& task)
+{
+#if defined(_OPENMP)
+	//MSVC only supports OpenMP 2.0, which requires a signed loop index
+	const int nrTasksSigned = static_cast<int>(nrTasks);
+
+	#pragma omp parallel for schedule(dynamic, 1)
+	for (int i = 0; i < nrTasksSigned; ++i)
+	{
+		task(static_cast<uint32_t>(i));
+	}
+#else
+	RunSerial(nrTasks, task);
+#endif
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+//Project includes
+#include "ThreadPool.h"
+
+namespace dae
+{
+	enum class SchedulerMode
+	{
+		Serial, //Everything on the calling thread
+		StaticPartition, //One contiguous block of tasks per worker
+		DynamicChunked, //Workers grab fixed size chunks from a shared counter
+		WorkStealing, //Per worker ranges, idle workers steal half of a busy worker's range
+		ParallelFor, //concurrency::parallel_for (PPL)
+		OpenMP, //#pragma omp parallel for, only when compiled with OpenMP support
+
+		End
+	};
+
+	class Scheduler final
+	{
+	public:
+		Scheduler();
+		~Scheduler() = default;
+
+		Scheduler(const Scheduler&) = delete;
+		Scheduler(Scheduler&&) noexcept = delete;
+		Scheduler& operator=(const Scheduler&) = delete;
+		Scheduler& operator=(Scheduler&&) noexcept = delete;
+
+		//Execute task(taskIndex) for every index in [0, nrTasks) with the current backend, returns when all tasks are done
+		void Run(uint32_t nrTasks, const std::function<void(uint32_t)>& task);
+
+		SchedulerMode GetMode() const { return m_Mode; }
+		void SetMode(SchedulerMode mode);
+		void CycleMode();
+
+		uint32_t GetNrWorkers() const { return m_pThreadPool->GetNrWorkers(); }
+
+		//Recreates the pool with nrWorkers threads (keeping the pinning), only affects the backends that run on the ThreadPool
+		void SetNrWorkers(uint32_t nrWorkers);
+		//Recreates the worker threads pinned (or unpinned) to cores, only affects the backends that run on the ThreadPool
+		void SetWorkerPinning(bool pinWorkers);
+		bool IsWorkerPinningEnabled() const { return m_pThreadPool->AreWorkersPinned(); }
+
+		static bool IsModeAvailable(SchedulerMode mode);
+		static const char* GetModeName(SchedulerMode mode);
+		static bool TryParseMode(const std::string& name, SchedulerMode& mode);
+
+	private:
+		std::unique_ptr<ThreadPool> m_pThreadPool{};
+		SchedulerMode m_Mode{ SchedulerMode::ParallelFor };
+
+		//Amount of tasks a worker grabs at once in DynamicChunked mode
+		static constexpr uint32_t m_ChunkSize{ 2 };
+
+		void RunSerial(uint32_t nrTasks, const std::function<void(uint32_t)>& task);
+		void RunStaticPartition(uint32_t nrTasks, const std::function<void(uint32_t)>& task);
+		void RunDynamicChunked(uint32_t nrTasks, const std::function<void(uint32_t)>& task);
+		void RunWorkStealing(uint32_t nrTasks, const std::function<void(uint32_t)>& task);
+		void RunParallelFor(uint32_t nrTasks, const std::function<void(uint32_t)>& task);
+		void RunOpenMP(uint32_t nrTasks, const std::function<void(uint32_t)>& task);
+	};
+}
@@ -0,0 +1,89 @@
+#include "ThreadPool.h"
+#include "Topology.h"
+
+using namespace dae;
+
+ThreadPool::ThreadPool(uint32_t nrWorkers, bool pinWorkers) :
+	m_AreWorkersPinned(pinWorkers)
+{
+	//hardware_concurrency is allowed to return 0 when it can't be determined
+	if (nrWorkers == 0)
+		nrWorkers = 1;
+
+	m_Workers.reserve(nrWorkers);
+	for (uint32_t i{ 0 }; i < nrWorkers; ++i)
+	{
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_IsStopping = true;
+	}
+	m_Condition.notify_all();
+
+	for (std::thread& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+std::future<void> ThreadPool::Submit(std::function<void()> task)
+{
+	std::packaged_task<void()> packagedTask{ std::move(task) };
+	std::future<void> future = packagedTask.get_future();
+
+	{
+		std::lock_guard lock{ m_Mutex };
+		m_Tasks.push_back(std::move(packagedTask));
+	}
+	m_Condition.notify_one();
+
+	return future;
+}
+
+void ThreadPool::RunSlots(uint32_t nrSlots, const std::function<void(uint32_t)>& task)
+{
+	std::vector<std::future<void>> futures{};
+	futures.reserve(nrSlots);
+
+	for (uint32_t slot{ 0 }; slot < nrSlots; ++slot)
+	{
+		futures.push_back(Submit([&task, slot] { task(slot); }));
+	}
+
+	//Wait for completion of all slots
+	for (const std::future<void>& f : futures)
+	{
+		f.wait();
+	}
+}
+
+void ThreadPool::WorkerLoop(uint32_t workerIndex)
+{
+	if (m_AreWorkersPinned)
+		Topology::PinCurrentThread(workerIndex);
+	else
+		Topology::RefreshCurrentNode();
+
+	while (true)
+	{
+		std::packaged_task<void()> task{};
+		{
+			std::unique_lock lock{ m_Mutex };
+			m_Condition.wait(lock, [this] { return m_IsStopping || !m_Tasks.empty(); });
+
+			//Finish queued work before shutting down
+			if (m_Tasks.empty())
+				return;
+
+			task = std::move(m_Tasks.front());
+			m_Tasks.pop_front();
+		}
+
+		task();
+	}
+}
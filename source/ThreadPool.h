@@ -0,0 +1,47 @@
+#pragma once
+
+//Standard includes
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dae
+{
+	class ThreadPool final
+	{
+	public:
+		//When pinWorkers is set every worker is bound to its own logical processor, spread over the NUMA nodes
+		explicit ThreadPool(uint32_t nrWorkers = std::thread::hardware_concurrency(), bool pinWorkers = false);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool(ThreadPool&&) noexcept = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+		ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+		//Queue a single task, the future becomes ready once a worker finished it
+		std::future<void> Submit(std::function<void()> task);
+
+		//Run task(slot) once for every slot in [0, nrSlots) and block until all of them returned
+		void RunSlots(uint32_t nrSlots, const std::function<void(uint32_t)>& task);
+
+		uint32_t GetNrWorkers() const { return static_cast<uint32_t>(m_Workers.size()); }
+		bool AreWorkersPinned() const { return m_AreWorkersPinned; }
+
+	private:
+		std::vector<std::thread> m_Workers{};
+		std::deque<std::packaged_task<void()>> m_Tasks{};
+
+		std::mutex m_Mutex{};
+		std::condition_variable m_Condition{};
+		bool m_IsStopping{ false };
+		bool m_AreWorkersPinned{ false };
+
+		void WorkerLoop(uint32_t workerIndex);
+	};
+}
@@ -74,6 +74,14 @@ void Timer::Update()
 		return;
 	}
 
+	//Simulated time, every frame moves the scene forward by the same amount (offline rendering)
+	if (m_FixedTimeStep > 0.0f)
+	{
+		m_ElapsedTime = m_FixedTimeStep;
+		m_TotalTime += m_FixedTimeStep;
+		return;
+	}
+
 	const uint64_t currentTime = SDL_GetPerformanceCounter();
 	m_CurrentTime = currentTime;
 
@@ -24,6 +24,9 @@ namespace dae
 		void Update();
 		void Stop();
 
+		//Every Update advances the clock by exactly timeStep seconds instead of the measured time (0 goes back to real time)
+		void SetFixedTimeStep(float timeStep) { m_FixedTimeStep = timeStep; }
+
 		uint32_t GetFPS() const { return m_FPS; };
 		float GetdFPS() const { return m_dFPS; };
 		float GetElapsed() const { return m_ElapsedTime; };
@@ -46,6 +49,7 @@ namespace dae
 		float m_SecondsPerCount = 0.0f;
 		float m_ElapsedUpperBound = 0.03f;
 		float m_FPSTimer = 0.0f;
+		float m_FixedTimeStep = 0.0f;
 
 		bool m_IsStopped = true;
 		bool m_ForceElapsedUpperBound = false;
@@ -0,0 +1,144 @@
+#include "ToneMapper.h"
+
+//Standard includes
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TONE_MAPPER_SSE2
+#endif
+
+using namespace dae;
+
+namespace
+{
+	//The colors are processed as one flat float array, every channel gets the same curve
+	static_assert(sizeof(ColorRGB) == 3 * sizeof(float));
+
+	inline float Reinhard(float x)
+	{
+		return x / (1.f + x);
+	}
+
+	inline float ACES(float x)
+	{
+		return (x * (2.51f * x + 0.03f)) / (x * (2.43f * x + 0.59f) + 0.14f);
+	}
+
+#if defined(TONE_MAPPER_SSE2)
+	inline __m128 Reinhard(__m128 x)
+	{
+		return _mm_div_ps(x, _mm_add_ps(_mm_set1_ps(1.f), x));
+	}
+
+	inline __m128 ACES(__m128 x)
+	{
+		const __m128 numerator = _mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.51f), x), _mm_set1_ps(0.03f)));
+		const __m128 denominator = _mm_add_ps(_mm_mul_ps(x, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(2.43f), x), _mm_set1_ps(0.59f))), _mm_set1_ps(0.14f));
+		return _mm_div_ps(numerator, denominator);
+	}
+#endif
+
+	template<typename Curve, typename SimdCurve>
+	void ApplyCurve(const float* pHdr, float* pDisplay, size_t count, float exposure, const float* pLut, size_t lutSize, Curve curve, SimdCurve simdCurve)
+	{
+		const float lutScale = static_cast<float>(lutSize - 1);
+		size_t i{ 0 };
+
+#if defined(TONE_MAPPER_SSE2)
+		const __m128 simdExposure = _mm_set1_ps(exposure);
+		const __m128 simdLutScale = _mm_set1_ps(lutScale);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.f);
+
+		alignas(16) int32_t indices[4]{};
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 value = _mm_max_ps(_mm_mul_ps(_mm_loadu_ps(pHdr + i), simdExposure), zero);
+			value = _mm_min_ps(simdCurve(value), one);
+
+			//Rounds to the nearest entry (default rounding mode), the table lookup itself has no SSE2 gather
+			_mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvtps_epi32(_mm_mul_ps(value, simdLutScale)));
+			pDisplay[i] = pLut[indices[0]];
+			pDisplay[i + 1] = pLut[indices[1]];
+			pDisplay[i + 2] = pLut[indices[2]];
+			pDisplay[i + 3] = pLut[indices[3]];
+		}
+#endif
+
+		for (; i < count; ++i)
+		{
+			//Written so NaN ends up in range like in the SSE2 path (the conversion to size_t is undefined for it):
+			//a NaN input becomes 0, a NaN curve result (Reinhard of infinity) becomes 1
+			const float x = pHdr[i] * exposure;
+			const float value = curve(!(x > 0.f) ? 0.f : x);
+			pDisplay[i] = pLut[static_cast<size_t>((!(value < 1.f) ? 1.f : value) * lutScale + 0.5f)];
+		}
+	}
+}
+
+ToneMapper::ToneMapper()
+{
+	for (size_t i{ 0 }; i < m_SrgbLutSize; ++i)
+	{
+		const float linear = i / static_cast<float>(m_SrgbLutSize - 1);
+		m_SrgbLut[i] = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.f / 2.4f) - 0.055f;
+	}
+}
+
+void ToneMapper::Apply(const ColorRGB* pHdr, ColorRGB* pDisplay, size_t count) const
+{
+	switch (m_Operator)
+	{
+	//Not a real operator, falls back to the original look
+	case ToneMappingOperator::End:
+	default:
+	case ToneMappingOperator::MaxToOne:
+		for (size_t i{ 0 }; i < count; ++i)
+		{
+			ColorRGB color = pHdr[i] * m_Exposure;
+			color.MaxToOne();
+			pDisplay[i] = color;
+		}
+		break;
+
+	case ToneMappingOperator::Reinhard:
+		ApplyCurve(&pHdr[0].r, &pDisplay[0].r, count * 3, m_Exposure, m_SrgbLut.data(), m_SrgbLutSize,
+			[](float x) { return Reinhard(x); }, [](auto x) { return Reinhard(x); });
+		break;
+
+	case ToneMappingOperator::ACES:
+		ApplyCurve(&pHdr[0].r, &pDisplay[0].r, count * 3, m_Exposure, m_SrgbLut.data(), m_SrgbLutSize,
+			[](float x) { return ACES(x); }, [](auto x) { return ACES(x); });
+		break;
+	}
+}
+
+const char* ToneMapper::GetOperatorName(ToneMappingOperator toneMappingOperator)
+{
+	switch (toneMappingOperator)
+	{
+	case ToneMappingOperator::MaxToOne:
+		return "maxtoone";
+	case ToneMappingOperator::Reinhard:
+		return "reinhard";
+	case ToneMappingOperator::ACES:
+		return "aces";
+	default:
+		return "unknown";
+	}
+}
+
+bool ToneMapper::TryParseOperator(const std::string& name, ToneMappingOperator& toneMappingOperator)
+{
+	for (int i{ 0 }; i < int(ToneMappingOperator::End); ++i)
+	{
+		if (name == GetOperatorName(ToneMappingOperator(i)))
+		{
+			toneMappingOperator = ToneMappingOperator(i);
+			return true;
+		}
+	}
+	return false;
+}
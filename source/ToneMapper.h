@@ -0,0 +1,56 @@
+#pragma once
+
+//Standard includes
+#include <array>
+#include <cstddef>
+#include <string>
+
+//Project includes
+#include "ColorRGB.h"
+
+namespace dae
+{
+	enum class ToneMappingOperator
+	{
+		MaxToOne, //Scales colors brighter than 1 back into range, linear output (the original look)
+		Reinhard, //x / (1 + x) per channel, sRGB encoded
+		ACES, //Filmic curve (Narkowicz's fit of the ACES reference transform), sRGB encoded
+
+		End
+	};
+
+	//Turns HDR radiance into display colors in [0, 1]: exposure, then the operator, then the sRGB transfer curve
+	class ToneMapper final
+	{
+	public:
+		ToneMapper();
+		~ToneMapper() = default;
+
+		ToneMapper(const ToneMapper&) = delete;
+		ToneMapper(ToneMapper&&) noexcept = delete;
+		ToneMapper& operator=(const ToneMapper&) = delete;
+		ToneMapper& operator=(ToneMapper&&) noexcept = delete;
+
+		//pDisplay may be the same array as pHdr
+		void Apply(const ColorRGB* pHdr, ColorRGB* pDisplay, size_t count) const;
+
+		ToneMappingOperator GetOperator() const { return m_Operator; }
+		void SetOperator(ToneMappingOperator toneMappingOperator) { m_Operator = toneMappingOperator; }
+		void CycleOperator() { m_Operator = ToneMappingOperator((int(m_Operator) + 1) % int(ToneMappingOperator::End)); }
+
+		//Linear multiplier applied before the operator
+		float GetExposure() const { return m_Exposure; }
+		void SetExposure(float exposure) { m_Exposure = exposure; }
+
+		static const char* GetOperatorName(ToneMappingOperator toneMappingOperator);
+		static bool TryParseOperator(const std::string& name, ToneMappingOperator& toneMappingOperator);
+
+	private:
+		ToneMappingOperator m_Operator{ ToneMappingOperator::MaxToOne };
+		float m_Exposure{ 1.f };
+
+		//Linear [0, 1] > sRGB encoded [0, 1]. 4096 entries stay in L1 and are within half an 8 bit step of the exact curve
+		static constexpr size_t m_SrgbLutSize{ 4096 };
+		std::array<float, m_SrgbLutSize> m_SrgbLut{};
+	};
+}
@@ -0,0 +1,85 @@
+#include "Topology.h"
+
+//Standard includes
+#include <bit>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#endif
+
+using namespace dae;
+
+namespace
+{
+	thread_local uint32_t t_CurrentNode{ 0 };
+	thread_local bool t_IsPinned{ false };
+}
+
+uint32_t Topology::GetNrNodes()
+{
+#if defined(_WIN32)
+	ULONG highestNode{};
+	if (GetNumaHighestNodeNumber(&highestNode))
+		return static_cast<uint32_t>(highestNode) + 1;
+#endif
+	return 1;
+}
+
+bool Topology::PinCurrentThread(uint32_t workerIndex)
+{
+#if defined(_WIN32)
+	const uint32_t nrNodes = GetNrNodes();
+	const USHORT node = static_cast<USHORT>(workerIndex % nrNodes);
+
+	//Only the first processor group of a node is used, nodes with more than 64 logical processors are not split up
+	GROUP_AFFINITY nodeAffinity{};
+	if (!GetNumaNodeProcessorMaskEx(node, &nodeAffinity) || nodeAffinity.Mask == 0)
+		return false;
+
+	//Pick the n-th processor of the node, wrapping around when there are more workers than processors
+	const uint32_t nrProcessors = static_cast<uint32_t>(std::popcount(static_cast<uint64_t>(nodeAffinity.Mask)));
+	uint32_t processorIndex = (workerIndex / nrNodes) % nrProcessors;
+
+	KAFFINITY processorMask = nodeAffinity.Mask;
+	while (processorIndex-- > 0)
+	{
+		//Clear lowest set bit
+		processorMask &= processorMask - 1;
+	}
+
+	GROUP_AFFINITY threadAffinity{};
+	threadAffinity.Group = nodeAffinity.Group;
+	threadAffinity.Mask = processorMask & (~processorMask + 1); //Lowest set bit only
+	if (!SetThreadGroupAffinity(GetCurrentThread(), &threadAffinity, nullptr))
+		return false;
+
+	t_CurrentNode = node;
+	t_IsPinned = true;
+	return true;
+#else
+	(void)workerIndex;
+	return false;
+#endif
+}
+
+void Topology::RefreshCurrentNode()
+{
+#if defined(_WIN32)
+	if (t_IsPinned)
+		return;
+
+	PROCESSOR_NUMBER processor{};
+	GetCurrentProcessorNumberEx(&processor);
+
+	USHORT node{};
+	if (GetNumaProcessorNodeEx(&processor, &node))
+		t_CurrentNode = node;
+#endif
+}
+
+uint32_t Topology::GetCurrentNode()
+{
+	return t_CurrentNode;
+}
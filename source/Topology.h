@@ -0,0 +1,23 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+
+namespace dae
+{
+	//Processor/NUMA topology helpers, only implemented for Windows (elsewhere everything is treated as a single node)
+	namespace Topology
+	{
+		uint32_t GetNrNodes();
+
+		//Pins the calling thread to a single logical processor. Workers are spread round-robin over the NUMA nodes
+		//so that every node gets an equal share, returns false if the thread could not be pinned
+		bool PinCurrentThread(uint32_t workerIndex);
+
+		//Re-queries the node of an unpinned thread (it may have been migrated), no-op for pinned threads
+		void RefreshCurrentNode();
+
+		//Cached NUMA node of the calling thread
+		uint32_t GetCurrentNode();
+	}
+}
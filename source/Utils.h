@@ -1,8 +1,9 @@
 #pragma once
 #include <cassert>
-#include <fstream>
+#include <cstdint>
 #include "Math.h"
 #include "DataTypes.h"
+#include "ObjParser.h"
 
 //#define HITTEST_SPHERE_ANALYTIC
 
@@ -221,21 +222,30 @@ namespace dae
 			// slabtest
 			if (!SlabTest_TriangleMesh(mesh, ray)) return false;
 
+			//Move the ray into object space instead of the mesh into world space, the direction isn't renormalized
+			//so t stays the same in both spaces
+			Ray objectRay{ ray };
+			objectRay.origin = mesh.inverseWorldTransform.TransformPoint(ray.origin);
+			objectRay.direction = mesh.inverseWorldTransform.TransformVector(ray.direction);
+
 			//Temporary value to pass to HitTest function
 			HitRecord record{};
 			Triangle triangle{};
 			triangle.cullMode = mesh.cullMode;
 
 			//Loop over all indices in sets of 3 (each triangle has 3 points)
-			for (size_t index{}; index < mesh.indices.size() - 2; index += 3)
+			const std::span<const Vector3> positions = mesh.GetPositions();
+			const std::span<const Vector3> normals = mesh.GetNormals();
+			const std::span<const int> indices = mesh.GetIndices();
+			for (size_t index{}; index + 2 < indices.size(); index += 3)
 			{
-				triangle.v0 = mesh.transformedPositions[mesh.indices[index]];
-				triangle.v1 = mesh.transformedPositions[mesh.indices[index + 1]];
-				triangle.v2 = mesh.transformedPositions[mesh.indices[index + 2]];
-				triangle.normal = mesh.transformedNormals[index / 3];
+				triangle.v0 = positions[indices[index]];
+				triangle.v1 = positions[indices[index + 1]];
+				triangle.v2 = positions[indices[index + 2]];
+				triangle.normal = normals[index / 3];
 
 				// If the ray hits a triangle in the mesh, check if it is closer then the previous hit triangle
-				if (HitTest_Triangle(triangle, ray, record, ignoreHitRecord))
+				if (HitTest_Triangle(triangle, objectRay, record, ignoreHitRecord))
 				{
 					// If the hit records needs to be ignored, it doesn't matter where the triangle is, so just return true
 					if (ignoreHitRecord) return true;
@@ -244,8 +254,8 @@ namespace dae
 					if (hitRecord.t > record.t)
 					{
 						hitRecord.didHit = true;
-						hitRecord.normal = record.normal;
-						hitRecord.origin = record.origin;
+						hitRecord.normal = mesh.worldTransform.TransformVector(record.normal);
+						hitRecord.origin = ray.origin + record.t * ray.direction;
 						hitRecord.t = record.t;
 					}
 				}
@@ -299,78 +309,27 @@ namespace dae
 
 	namespace Utils
 	{
+		//Start value for HashBytes
+		constexpr uint64_t HASH_BASIS = 14695981039346656037ull;
+
+		//FNV-1a, continues from hash (HASH_BASIS for a new one). Fast change detection, not collision proof
+		inline uint64_t HashBytes(uint64_t hash, const void* pData, size_t size)
+		{
+			const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+			for (size_t i{ 0 }; i < size; ++i)
+			{
+				hash ^= pBytes[i];
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+
 		//Just parses vertices and indices
 #pragma warning(push)
 #pragma warning(disable : 4505) //Warning unreferenced local function
 		static bool ParseOBJ(const std::string& filename, std::vector<Vector3>& positions, std::vector<Vector3>& normals, std::vector<int>& indices)
 		{
-			std::ifstream file(filename);
-			if (!file)
-				return false;
-
-			std::string sCommand;
-			// start a while iteration ending when the end of file is reached (ios::eof)
-			while (!file.eof())
-			{
-				//read the first word of the string, use the >> operator (istream::operator>>) 
-				file >> sCommand;
-				//use conditional statements to process the different commands	
-				if (sCommand == "#")
-				{
-					// Ignore Comment
-				}
-				else if (sCommand == "v")
-				{
-					//Vertex
-					float x, y, z;
-					file >> x >> y >> z;
-					positions.push_back({ x, y, z });
-				}
-				else if (sCommand == "f")
-				{
-					std::string i0, i1, i2;
-					file >> i0 >> i1 >> i2;
-
-					if (i0 != "")
-					{
-						indices.push_back((int)stoi(i0) - 1);
-						indices.push_back((int)stoi(i1) - 1);
-						indices.push_back((int)stoi(i2) - 1);
-					}
-				}
-				//read till end of line and ignore all remaining chars
-				file.ignore(1000, '\n');
-
-				if (file.eof())
-					break;
-			}
-
-			//Precompute normals
-			for (uint64_t index = 0; index < indices.size(); index += 3)
-			{
-				uint32_t i0 = indices[index];
-				uint32_t i1 = indices[index + 1];
-				uint32_t i2 = indices[index + 2];
-
-				Vector3 edgeV0V1 = positions[i1] - positions[i0];
-				Vector3 edgeV0V2 = positions[i2] - positions[i0];
-				Vector3 normal = Vector3::Cross(edgeV0V1, edgeV0V2);
-
-				if (isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normal.Normalize();
-				if (isnan(normal.x))
-				{
-					int k = 0;
-				}
-
-				normals.push_back(normal);
-			}
-
-			return true;
+			return ObjParser::Parse(filename, positions, normals, indices);
 		}
 #pragma warning(pop)
 	}
@@ -0,0 +1,174 @@
+#include "VideoStream.h"
+
+//Standard includes
+#include <algorithm>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <csignal>
+#include <sys/stat.h>
+#endif
+
+using namespace dae;
+
+VideoStream::VideoStream(const std::string& target, VideoFormat format, uint32_t fps) :
+	m_Format(format),
+	m_Fps(fps)
+{
+	if (target == "-")
+	{
+	#if defined(_WIN32)
+		//No newline translation
+		_setmode(_fileno(stdout), _O_BINARY);
+	#endif
+		m_pFile = stdout;
+		return;
+	}
+
+#if defined(_WIN32)
+	if (target.rfind("\\\\.\\pipe\\", 0) == 0)
+	{
+		HANDLE pipe = CreateNamedPipeA(target.c_str(), PIPE_ACCESS_OUTBOUND, PIPE_TYPE_BYTE | PIPE_WAIT, 1, 1 << 20, 0, 0, nullptr);
+		if (pipe == INVALID_HANDLE_VALUE)
+			return;
+
+		//Blocks until the encoder opens the pipe
+		if (!ConnectNamedPipe(pipe, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED)
+		{
+			CloseHandle(pipe);
+			return;
+		}
+
+		m_PipeHandle = pipe;
+		return;
+	}
+#else
+	//A consumer that quits should fail the write, not kill the process
+	std::signal(SIGPIPE, SIG_IGN);
+
+	struct stat fileStats{};
+	if (stat(target.c_str(), &fileStats) != 0)
+		mkfifo(target.c_str(), 0644);
+#endif
+
+	//Opening a FIFO blocks until the encoder opens the other end
+	m_pFile = std::fopen(target.c_str(), "wb");
+	m_OwnsFile = m_pFile != nullptr;
+}
+
+VideoStream::~VideoStream()
+{
+	if (m_pFile)
+		std::fflush(m_pFile);
+
+	if (m_OwnsFile)
+		std::fclose(m_pFile);
+
+#if defined(_WIN32)
+	if (m_PipeHandle)
+	{
+		FlushFileBuffers(m_PipeHandle);
+		DisconnectNamedPipe(m_PipeHandle);
+		CloseHandle(m_PipeHandle);
+	}
+#endif
+}
+
+bool VideoStream::IsOpen() const
+{
+#if defined(_WIN32)
+	if (m_PipeHandle)
+		return true;
+#endif
+	return m_pFile != nullptr;
+}
+
+bool VideoStream::WriteFrame(const Frame& frame)
+{
+	if (!IsOpen())
+		return false;
+
+	//The stream header fixes the size
+	if (m_Width == 0)
+	{
+		m_Width = frame.width;
+		m_Height = frame.height;
+
+		if (m_Format == VideoFormat::Y4M)
+		{
+			const std::string header = "YUV4MPEG2 W" + std::to_string(m_Width) + " H" + std::to_string(m_Height)
+				+ " F" + std::to_string(m_Fps) + ":1 Ip A1:1 C444\n";
+			if (!Write(header.data(), header.size()))
+				return false;
+		}
+	}
+
+	if (frame.width != m_Width || frame.height != m_Height)
+		return false;
+
+	if (m_Format == VideoFormat::RawRGB)
+	{
+		frame.ToRGB(m_ConvertedPixels);
+		return Write(m_ConvertedPixels.data(), m_ConvertedPixels.size());
+	}
+
+	//Planar Y, Cb, Cr with BT.601 limited range coefficients (8 bit fixed point)
+	const size_t nrPixels = frame.pixels.size();
+	m_ConvertedPixels.resize(nrPixels * 3);
+	uint8_t* pY = m_ConvertedPixels.data();
+	uint8_t* pCb = pY + nrPixels;
+	uint8_t* pCr = pCb + nrPixels;
+	for (size_t i{ 0 }; i < nrPixels; ++i)
+	{
+		const uint32_t pixel = frame.pixels[i];
+		const int r = (pixel >> frame.layout.redShift) & 0xFF;
+		const int g = (pixel >> frame.layout.greenShift) & 0xFF;
+		const int b = (pixel >> frame.layout.blueShift) & 0xFF;
+
+		pY[i] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+		pCb[i] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+		pCr[i] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+	}
+
+	constexpr char frameHeader[]{ "FRAME\n" };
+	return Write(frameHeader, sizeof(frameHeader) - 1) && Write(m_ConvertedPixels.data(), m_ConvertedPixels.size());
+}
+
+bool VideoStream::TryParseFormat(const std::string& name, VideoFormat& format)
+{
+	if (name == "rgb")
+		format = VideoFormat::RawRGB;
+	else if (name == "y4m")
+		format = VideoFormat::Y4M;
+	else
+		return false;
+
+	return true;
+}
+
+bool VideoStream::Write(const void* pData, size_t size)
+{
+#if defined(_WIN32)
+	if (m_PipeHandle)
+	{
+		const char* pBytes = static_cast<const char*>(pData);
+		while (size > 0)
+		{
+			DWORD nrWritten{};
+			if (!WriteFile(m_PipeHandle, pBytes, static_cast<DWORD>(std::min<size_t>(size, 1 << 30)), &nrWritten, nullptr))
+				return false;
+
+			pBytes += nrWritten;
+			size -= nrWritten;
+		}
+		return true;
+	}
+#endif
+
+	return std::fwrite(pData, 1, size, m_pFile) == size;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+//Standard includes
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//Project includes
+#include "FrameQueue.h"
+
+namespace dae
+{
+	enum class VideoFormat
+	{
+		RawRGB, //Headerless rgb24 frames (ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH -r fps -i ...)
+		Y4M //YUV4MPEG2 with 4:4:4 BT.601 frames, self describing (ffmpeg -i ...)
+	};
+
+	//Uncompressed video written to stdout, a named pipe or a file, meant to be consumed by an external encoder.
+	//Writes block while the consumer isn't reading, which together with a FrameQueue throttles the renderer
+	class VideoStream final
+	{
+	public:
+		//target: "-" for stdout, on Windows \\.\pipe\<name> creates a pipe and waits for the encoder to connect,
+		//elsewhere a path that doesn't exist yet is created as a FIFO. Anything else is opened as a regular file
+		VideoStream(const std::string& target, VideoFormat format, uint32_t fps);
+		~VideoStream();
+
+		VideoStream(const VideoStream&) = delete;
+		VideoStream(VideoStream&&) noexcept = delete;
+		VideoStream& operator=(const VideoStream&) = delete;
+		VideoStream& operator=(VideoStream&&) noexcept = delete;
+
+		bool IsOpen() const;
+		//Converts and writes a frame, all frames need the size of the first one. Returns false if the consumer went away
+		bool WriteFrame(const Frame& frame);
+
+		static bool TryParseFormat(const std::string& name, VideoFormat& format);
+
+	private:
+		VideoFormat m_Format{};
+		uint32_t m_Fps{};
+		uint32_t m_Width{ 0 };
+		uint32_t m_Height{ 0 };
+
+		std::FILE* m_pFile{ nullptr };
+		bool m_OwnsFile{ false };
+	#if defined(_WIN32)
+		void* m_PipeHandle{ nullptr };
+	#endif
+
+		std::vector<uint8_t> m_ConvertedPixels{};
+
+		bool Write(const void* pData, size_t size);
+	};
+}
@@ -5,12 +5,22 @@
 #undef main
 
 //Standard includes
+#include <cctype>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
 
 //Project includes
 #include "Timer.h"
 #include "Renderer.h"
 #include "Scene.h"
+#include "FrameQueue.h"
+#include "ImageWriter.h"
+#include "VideoStream.h"
 
 using namespace dae;
 
@@ -20,39 +30,538 @@ void ShutDown(SDL_Window* pWindow)
 	SDL_Quit();
 }
 
-int main(int argc, char* args[])
+Scene* CreateScene(const std::string& name)
+{
+	if (name == "W1") return new Scene_W1();
+	if (name == "W2") return new Scene_W2();
+	if (name == "W3_TestScene") return new Scene_W3_TestScene();
+	if (name == "W3_Scene") return new Scene_W3_Scene();
+	if (name == "W4_TestScene") return new Scene_W4_TestScene();
+	if (name == "W4_ReferenceScene") return new Scene_W4_ReferenceScene();
+	if (name == "W4_BunnyScene") return new Scene_W4_BunnyScene();
+	if (name == "TestExtra") return new Scene_TestExtra();
+	if (name == "Extra") return new Scene_Extra();
+
+	//Anything else is taken as a scene description file
+	if (std::ifstream{ name })
+		return new Scene_File(name);
+
+	return nullptr;
+}
+
+//Comma separated floats, e.g. "0,3,-9"
+std::vector<float> ParseFloatList(const std::string& text)
+{
+	std::vector<float> values{};
+	std::stringstream stream{ text };
+	std::string value{};
+	while (std::getline(stream, value, ','))
+	{
+		values.push_back(std::stof(value));
+	}
+	return values;
+}
+
+//Frame number gets appended when rendering a sequence: render.png > render_0000.png, render_0001.png, ...
+std::string GetFrameFilename(const std::string& filename, uint32_t frame, uint32_t nrFrames)
+{
+	if (nrFrames <= 1)
+		return filename;
+
+	char frameNumber[16]{};
+	std::snprintf(frameNumber, sizeof(frameNumber), "_%04u", frame);
+
+	const size_t dotPosition = filename.find_last_of('.');
+	if (dotPosition == std::string::npos)
+		return filename + frameNumber;
+
+	return filename.substr(0, dotPosition) + frameNumber + filename.substr(dotPosition);
+}
+
+//Keys that change how frames are traced, a frame that is being traced has to be canceled first
+bool IsRenderSettingKey(SDL_Scancode key)
+{
+	switch (key)
+	{
+	case SDL_SCANCODE_F1:
+	case SDL_SCANCODE_F2:
+	case SDL_SCANCODE_F3:
+	case SDL_SCANCODE_F4:
+	case SDL_SCANCODE_F5:
+	case SDL_SCANCODE_F7:
+	case SDL_SCANCODE_F8:
+	case SDL_SCANCODE_F9:
+	case SDL_SCANCODE_F11:
+	case SDL_SCANCODE_F12:
+	case SDL_SCANCODE_C:
+	case SDL_SCANCODE_V:
+	case SDL_SCANCODE_U:
+	case SDL_SCANCODE_KP_PLUS:
+	case SDL_SCANCODE_KP_MINUS:
+		return true;
+	default:
+		return false;
+	}
+}
+
+//Command line options, printed when an argument can't be parsed
+void PrintUsage()
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	std::cout << "Options:\n"
+		"  --scheduler <serial|static|dynamic|workstealing|parallelfor|openmp>\n"
+		"  --benchmark-schedulers [frames] >> benchmark every scheduler backend on the scene and quit\n"
+		"  --benchmark-tile-buffers [frames] >> compare direct and tile buffered writes at increasing worker counts and quit\n"
+		"  --pin-threads >> bind the render workers to cores\n"
+		"  --numa-replicas >> give every NUMA node its own copy of the scene geometry\n"
+		"  --progressive [budgetMs] >> start in progressive mode with the given frame budget\n"
+		"  --checkerboard >> trace half of the pixels per frame and reconstruct the other half from the previous frame\n"
+		"  --adaptive >> trace a coarse grid and only refine the blocks that aren't smooth, interpolate the rest\n"
+		"  --cancelable >> abort the frame that is being traced as soon as the camera moves and start over\n"
+		"  --dynamic-resolution [targetFps] >> scale the render resolution to hold the target frame rate\n"
+		"  --render-scale <0.25-1> >> fixed fraction of the output resolution to trace at, while dynamic resolution is off\n"
+		"  --edge-aware-upscaling >> upscale reduced resolution frames without blending across object edges\n"
+		"  --accumulate >> average jittered frames while the view doesn't change, converges to an anti-aliased image\n"
+		"  --no-dirty-regions >> retrace every pixel every frame, even when only a few objects moved\n"
+		"  --gbuffer >> keep the primary hits, so lighting changes re-shade the frame without tracing the view rays again\n"
+		"  --tonemap <maxtoone|reinhard|aces>\n"
+		"  --exposure <value> >> linear multiplier applied to the radiance before tone mapping\n"
+		"  --scene <W1|W2|W3_TestScene|W3_Scene|W4_TestScene|W4_ReferenceScene|W4_BunnyScene|TestExtra|Extra|file.scene>\n"
+		"  --resolution <width>x<height>\n"
+		"  --camera <x,y,z[,pitch,yaw[,fov]]> >> angles in degrees, overrides the scene's camera\n"
+		"  --headless >> no window: render --frames frames (at a fixed 30 fps time step) to --output and quit\n"
+		"  --frames <count>\n"
+		"  --output <file.ppm|file.png|file.exr> >> frame number gets appended when rendering more than one frame\n"
+		"  --strips >> headless: trace and write the output a strip of rows at a time, for resolutions too large to keep in memory\n"
+		"  --stream <-|pipe> >> stream every presented frame (headless: every frame, instead of --output) to stdout or a named pipe\n"
+		"  --stream-format <rgb|y4m>\n"
+		"  --stream-fps <fps> >> frame rate written in the y4m header\n";
+}
 
-	//Create window + surfaces
-	SDL_Init(SDL_INIT_VIDEO);
+int main(int argc, char* args[])
+{
+	std::string schedulerName{};
+	bool benchmarkSchedulers = false;
+	bool benchmarkTileBuffers = false;
+	bool pinThreads = false;
+	bool numaReplicas = false;
+	bool progressive = false;
+	bool checkerboard = false;
+	bool adaptive = false;
+	float progressiveBudgetMs = 1000.f / 30.f;
+	bool cancelableFrames = false;
+	bool accumulate = false;
+	bool dirtyRegions = true;
+	bool gBuffer = false;
+	float renderScale = 1.f;
+	bool edgeAwareUpscaling = false;
+	bool dynamicResolution = false;
+	float targetFps = 30.f;
+	std::string toneMappingName{};
+	float exposure = 1.f;
+	uint32_t nrBenchmarkFrames = 20;
+	std::string sceneName{ "W4_ReferenceScene" };
+	uint32_t width = 640;
+	uint32_t height = 480;
+	std::vector<float> cameraSettings{};
+	bool headless = false;
+	uint32_t nrHeadlessFrames = 1;
+	std::string outputFilename{ "render.png" };
+	bool renderStrips = false;
+	std::string streamTarget{};
+	VideoFormat streamFormat{ VideoFormat::Y4M };
+	uint32_t streamFps = 30;
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		const std::string arg{ args[i] };
+		//std::stoul and std::stof throw on values that aren't numbers or don't fit
+		try
+		{
+			if (arg == "--scheduler" && i + 1 < argc)
+			{
+				schedulerName = args[++i];
+			}
+			else if (arg == "--benchmark-schedulers")
+			{
+				benchmarkSchedulers = true;
+				if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(args[i + 1][0])))
+					nrBenchmarkFrames = static_cast<uint32_t>(std::stoul(args[++i]));
+			}
+			else if (arg == "--benchmark-tile-buffers")
+			{
+				benchmarkTileBuffers = true;
+				if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(args[i + 1][0])))
+					nrBenchmarkFrames = static_cast<uint32_t>(std::stoul(args[++i]));
+			}
+			else if (arg == "--pin-threads")
+			{
+				pinThreads = true;
+			}
+			else if (arg == "--numa-replicas")
+			{
+				numaReplicas = true;
+			}
+			else if (arg == "--progressive")
+			{
+				progressive = true;
+				if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(args[i + 1][0])))
+					progressiveBudgetMs = std::stof(args[++i]);
+			}
+			else if (arg == "--checkerboard")
+			{
+				checkerboard = true;
+			}
+			else if (arg == "--adaptive")
+			{
+				adaptive = true;
+			}
+			else if (arg == "--cancelable")
+			{
+				cancelableFrames = true;
+			}
+			else if (arg == "--accumulate")
+			{
+				accumulate = true;
+			}
+			else if (arg == "--no-dirty-regions")
+			{
+				dirtyRegions = false;
+			}
+			else if (arg == "--gbuffer")
+			{
+				gBuffer = true;
+			}
+			else if (arg == "--dynamic-resolution")
+			{
+				dynamicResolution = true;
+				if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(args[i + 1][0])))
+					targetFps = std::stof(args[++i]);
+			}
+			else if (arg == "--render-scale" && i + 1 < argc)
+			{
+				renderScale = std::stof(args[++i]);
+			}
+			else if (arg == "--edge-aware-upscaling")
+			{
+				edgeAwareUpscaling = true;
+			}
+			else if (arg == "--tonemap" && i + 1 < argc)
+			{
+				toneMappingName = args[++i];
+			}
+			else if (arg == "--exposure" && i + 1 < argc)
+			{
+				exposure = std::stof(args[++i]);
+			}
+			else if (arg == "--scene" && i + 1 < argc)
+			{
+				sceneName = args[++i];
+			}
+			else if (arg == "--resolution" && i + 1 < argc)
+			{
+				const std::string resolution{ args[++i] };
+				const size_t separator = resolution.find('x');
+				if (separator != std::string::npos)
+				{
+					width = static_cast<uint32_t>(std::stoul(resolution.substr(0, separator)));
+					height = static_cast<uint32_t>(std::stoul(resolution.substr(separator + 1)));
+				}
+			}
+			else if (arg == "--camera" && i + 1 < argc)
+			{
+				cameraSettings = ParseFloatList(args[++i]);
+			}
+			else if (arg == "--headless")
+			{
+				headless = true;
+			}
+			else if (arg == "--frames" && i + 1 < argc)
+			{
+				nrHeadlessFrames = static_cast<uint32_t>(std::stoul(args[++i]));
+			}
+			else if (arg == "--output" && i + 1 < argc)
+			{
+				outputFilename = args[++i];
+			}
+			else if (arg == "--strips")
+			{
+				renderStrips = true;
+			}
+			else if (arg == "--stream" && i + 1 < argc)
+			{
+				streamTarget = args[++i];
+			}
+			else if (arg == "--stream-format" && i + 1 < argc)
+			{
+				if (!VideoStream::TryParseFormat(args[++i], streamFormat))
+					std::cout << "Unknown stream format '" << args[i] << "', using y4m" << std::endl;
+			}
+			else if (arg == "--stream-fps" && i + 1 < argc)
+			{
+				streamFps = static_cast<uint32_t>(std::stoul(args[++i]));
+			}
+		}
+		catch (const std::logic_error&)
+		{
+			std::cout << "Invalid value for '" << arg << "'" << std::endl;
+			PrintUsage();
+			return 1;
+		}
+	}
 
-	const uint32_t width = 640;
-	const uint32_t height = 480;
+	//Strips go straight to the file, streaming and the benchmark need whole frames
+	renderStrips = renderStrips && headless && streamTarget.empty() && !benchmarkSchedulers && !benchmarkTileBuffers;
 
-	SDL_Window* pWindow = SDL_CreateWindow(
-		"RayTracer - **Jolan Plaum (2DAE08)**",
-		SDL_WINDOWPOS_UNDEFINED,
-		SDL_WINDOWPOS_UNDEFINED,
-		width, height, 0);
+	//stdout carries the video, all logging goes to stderr instead
+	if (streamTarget == "-")
+		std::cout.rdbuf(std::cerr.rdbuf());
 
-	if (!pWindow)
+	Scene* pScene = CreateScene(sceneName);
+	if (!pScene)
+	{
+		std::cout << "Unknown scene '" << sceneName << "'" << std::endl;
 		return 1;
+	}
+
+	//Create window + surfaces (headless renders into an owned buffer instead)
+	SDL_Window* pWindow = nullptr;
+	if (!headless)
+	{
+		SDL_Init(SDL_INIT_VIDEO);
+
+		pWindow = SDL_CreateWindow(
+			"RayTracer - **Jolan Plaum (2DAE08)**",
+			SDL_WINDOWPOS_UNDEFINED,
+			SDL_WINDOWPOS_UNDEFINED,
+			width, height, 0);
+
+		if (!pWindow)
+		{
+			delete pScene;
+			return 1;
+		}
+	}
 
 	//Initialize "framework"
 	const auto pTimer = new Timer();
-	const auto pRenderer = new Renderer(pWindow);
+	const auto pRenderer = renderStrips ? new Renderer()
+		: headless ? new Renderer(static_cast<int>(width), static_cast<int>(height))
+		: new Renderer(pWindow);
+	pRenderer->SetThreadPinning(pinThreads);
+	pRenderer->SetNumaReplication(numaReplicas);
+	pRenderer->SetProgressiveBudget(progressiveBudgetMs / 1000.f);
+	pRenderer->SetTargetFrameTime(1.f / targetFps);
+	//Progressive, checkerboard, adaptive sampling and dynamic resolution trade quality for responsiveness, offline frames are always traced in full
+	if (!headless)
+	{
+		if (progressive)
+			pRenderer->ToggleProgressive();
+		if (checkerboard)
+			pRenderer->ToggleCheckerboard();
+		if (adaptive)
+			pRenderer->ToggleAdaptiveSampling();
+		if (dynamicResolution)
+			pRenderer->ToggleDynamicResolution();
+	}
+	//Strips are traced straight at the output resolution
+	if (!renderStrips)
+		pRenderer->SetFixedRenderScale(renderScale);
+	if (edgeAwareUpscaling)
+		pRenderer->ToggleEdgeAwareUpscaling();
+	if (accumulate)
+		pRenderer->ToggleAccumulation();
+	pRenderer->SetDirtyRegions(dirtyRegions);
+	if (gBuffer)
+		pRenderer->ToggleGBuffer();
 
-	const auto pScene = new Scene_W4_ReferenceScene();
 	pScene->Initialize();
 
+	if (const Scene_File* pFileScene = dynamic_cast<const Scene_File*>(pScene); pFileScene && !pFileScene->IsLoaded())
+	{
+		delete pScene;
+		delete pRenderer;
+		delete pTimer;
+
+		ShutDown(pWindow);
+		return 1;
+	}
+
+	if (cameraSettings.size() >= 3)
+	{
+		Camera& camera = pScene->GetCamera();
+		camera.origin = { cameraSettings[0], cameraSettings[1], cameraSettings[2] };
+		if (cameraSettings.size() >= 5)
+		{
+			camera.totalPitch = cameraSettings[3] * TO_RADIANS;
+			camera.totalYaw = cameraSettings[4] * TO_RADIANS;
+		}
+		if (cameraSettings.size() >= 6)
+		{
+			camera.fovAngle = cameraSettings[5];
+			camera.fov = tanf(camera.fovAngle / 2.f * TO_RADIANS);
+		}
+	}
+
+	if (!schedulerName.empty())
+	{
+		SchedulerMode mode{};
+		if (Scheduler::TryParseMode(schedulerName, mode))
+			pRenderer->SetSchedulerMode(mode);
+		else
+			std::cout << "Unknown or unavailable scheduler '" << schedulerName << "', using " << pRenderer->GetSchedulerName() << std::endl;
+	}
+
+	if (!toneMappingName.empty())
+	{
+		ToneMappingOperator toneMappingOperator{};
+		if (ToneMapper::TryParseOperator(toneMappingName, toneMappingOperator))
+			pRenderer->SetToneMapping(toneMappingOperator);
+		else
+			std::cout << "Unknown tone mapping operator '" << toneMappingName << "', using " << pRenderer->GetToneMappingName() << std::endl;
+	}
+	pRenderer->SetExposure(exposure);
+
+	if (benchmarkSchedulers || benchmarkTileBuffers)
+	{
+		if (benchmarkSchedulers)
+			pRenderer->RunSchedulerBenchmark(pScene, nrBenchmarkFrames);
+		if (benchmarkTileBuffers)
+			pRenderer->RunTileBufferBenchmark(pScene, nrBenchmarkFrames);
+
+		delete pScene;
+		delete pRenderer;
+		delete pTimer;
+
+		ShutDown(pWindow);
+		return 0;
+	}
+
+	//Frames are converted and written on the queue's thread, a slow encoder blocks the queue and with that the render loop
+	VideoStream* pVideoStream = nullptr;
+	FrameQueue* pStreamQueue = nullptr;
+	if (!streamTarget.empty())
+	{
+		std::cout << "Waiting for the stream consumer..." << std::endl;
+		pVideoStream = new VideoStream(streamTarget, streamFormat, streamFps);
+		if (!pVideoStream->IsOpen())
+		{
+			std::cout << "Could not open stream '" << streamTarget << "'" << std::endl;
+			delete pVideoStream;
+			delete pScene;
+			delete pRenderer;
+			delete pTimer;
+
+			ShutDown(pWindow);
+			return 1;
+		}
+
+		pStreamQueue = new FrameQueue([pVideoStream](const Frame& frame) { return pVideoStream->WriteFrame(frame); });
+	}
+
+	if (headless)
+	{
+		//Every mesh has to be in the first frame
+		pScene->WaitForLoading();
+		if (pScene->GetNrFailedLoads() > 0)
+		{
+			delete pStreamQueue;
+			delete pVideoStream;
+			delete pScene;
+			delete pRenderer;
+			delete pTimer;
+			return 1;
+		}
+
+		pTimer->SetFixedTimeStep(1.f / 30.f);
+		pTimer->Start();
+
+		//No framebuffer at all, every frame is traced and written a strip at a time
+		if (renderStrips)
+		{
+			int result = 0;
+			for (uint32_t frame{ 0 }; frame < nrHeadlessFrames; ++frame)
+			{
+				pScene->Update(pTimer);
+
+				const std::string filename = GetFrameFilename(outputFilename, frame, nrHeadlessFrames);
+				if (!pRenderer->RenderToImage(pScene, filename, width, height))
+				{
+					std::cout << "Something went wrong. " << filename << " not saved!" << std::endl;
+					result = 1;
+					break;
+				}
+				std::cout << "Saved " << filename << std::endl;
+
+				pTimer->Update();
+			}
+
+			delete pScene;
+			delete pRenderer;
+			delete pTimer;
+			return result;
+		}
+
+		//Frames are written on the queue's thread while the next one is traced, either to the stream or as images
+		FrameQueue* pOutputQueue = nullptr;
+		if (!pStreamQueue)
+		{
+			pOutputQueue = new FrameQueue([&, rgbPixels = std::vector<uint8_t>{}](const Frame& frame) mutable
+				{
+					const std::string filename = GetFrameFilename(outputFilename, static_cast<uint32_t>(frame.index), nrHeadlessFrames);
+					frame.ToRGB(rgbPixels);
+					if (!ImageWriter::Write(filename, rgbPixels.data(), frame.width, frame.height))
+					{
+						std::cout << "Something went wrong. " << filename << " not saved!" << std::endl;
+						return false;
+					}
+
+					std::cout << "Saved " << filename << std::endl;
+					return true;
+				});
+		}
+
+		FrameQueue* pFrameQueue = pStreamQueue ? pStreamQueue : pOutputQueue;
+		for (uint32_t frame{ 0 }; frame < nrHeadlessFrames && pFrameQueue->GetNrFailedFrames() == 0; ++frame)
+		{
+			pScene->Update(pTimer);
+			pRenderer->Render(pScene);
+			pTimer->Update();
+
+			pRenderer->CaptureFrame(*pFrameQueue);
+		}
+
+		pFrameQueue->Flush();
+		const int result = pFrameQueue->GetNrFailedFrames() == 0 ? 0 : 1;
+
+		delete pOutputQueue;
+		delete pStreamQueue;
+		delete pVideoStream;
+		delete pScene;
+		delete pRenderer;
+		delete pTimer;
+		return result;
+	}
+
 	//Start loop
 	pTimer->Start();
+	//The scene clock only advances when a frame is begun, pTimer ticks every (much shorter) loop
+	const auto pSceneTimer = new Timer();
+	pSceneTimer->Start();
 	float printTimer = 0.f;
+	uint32_t nrPresentedFrames = 0;
+	float frameTime = 0.f;
 	bool isLooping = true;
 	bool takeScreenshot = false;
+	bool isRecording = false;
+	//Screenshots and recordings are written in the background to numbered files
+	const auto pScreenshotQueue = new FrameQueue([writeImage = ImageWriter::CreateSequenceWriter("RayTracing_Screenshot", "png")](const Frame& frame) mutable
+		{
+			const bool isSaved = writeImage(frame);
+			std::cout << (isSaved ? "Screenshot saved!" : "Something went wrong. Screenshot not saved!") << std::endl;
+			return isSaved;
+		});
+	FrameQueue* pRecordingQueue = nullptr;
+	bool isFramePresented = true;
+	int result = 0;
 	while (isLooping)
 	{
 		//--------- Get input events ---------
@@ -65,50 +574,171 @@ int main(int argc, char* args[])
 				isLooping = false;
 				break;
 			case SDL_KEYUP:
+				if (IsRenderSettingKey(e.key.keysym.scancode))
+					pRenderer->CancelFrame();
+
 				if (e.key.keysym.scancode == SDL_SCANCODE_X)
 					takeScreenshot = true;
+				if (e.key.keysym.scancode == SDL_SCANCODE_F1)
+				{
+					pRenderer->ToggleAccumulation();
+					std::cout << "Accumulation: " << (pRenderer->IsAccumulationEnabled() ? "ON" : "OFF") << std::endl;
+				}
 				if (e.key.keysym.scancode == SDL_SCANCODE_F2)
 					pRenderer->ToggleShadows();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F3)
 					pRenderer->CycleLightingMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F4)
+				{
+					pRenderer->CycleSchedulerMode();
+					std::cout << "Scheduler: " << pRenderer->GetSchedulerName() << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F5)
+					pRenderer->TogglePixelMapping();
 				if (e.key.keysym.scancode == SDL_SCANCODE_F6)
 					pTimer->StartBenchmark();
+				if (e.key.keysym.scancode == SDL_SCANCODE_F7)
+					pRenderer->RunSchedulerBenchmark(pScene);
+				if (e.key.keysym.scancode == SDL_SCANCODE_F8)
+				{
+					pRenderer->ToggleProgressive();
+					std::cout << "Progressive: " << (pRenderer->IsProgressiveEnabled() ? "ON" : "OFF") << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_C)
+				{
+					pRenderer->ToggleCheckerboard();
+					std::cout << "Checkerboard: " << (pRenderer->IsCheckerboardEnabled() ? "ON" : "OFF") << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_V)
+				{
+					pRenderer->ToggleAdaptiveSampling();
+					std::cout << "Adaptive sampling: " << (pRenderer->IsAdaptiveSamplingEnabled() ? "ON" : "OFF") << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_U)
+				{
+					pRenderer->ToggleEdgeAwareUpscaling();
+					std::cout << "Edge-aware upscaling: " << (pRenderer->IsEdgeAwareUpscalingEnabled() ? "ON" : "OFF") << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F10)
+				{
+					isRecording = !isRecording;
+					if (isRecording)
+					{
+						pRecordingQueue = new FrameQueue(ImageWriter::CreateSequenceWriter("RayTracing_Recording", "png"));
+					}
+					else
+					{
+						//Waits for the frames that are still queued
+						std::cout << "Recorded " << pRecordingQueue->GetNrPushedFrames() << " frames" << std::endl;
+						delete pRecordingQueue;
+						pRecordingQueue = nullptr;
+					}
+					std::cout << "Recording: " << (isRecording ? "ON" : "OFF") << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F9)
+				{
+					pRenderer->ToggleDynamicResolution();
+					std::cout << "Dynamic Resolution: " << (pRenderer->IsDynamicResolutionEnabled() ? "ON" : "OFF") << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F11)
+				{
+					pRenderer->CycleToneMapping();
+					std::cout << "Tone mapping: " << pRenderer->GetToneMappingName() << std::endl;
+				}
+				if (e.key.keysym.scancode == SDL_SCANCODE_F12)
+				{
+					pRenderer->ToggleGBuffer();
+					std::cout << "G-buffer: " << (pRenderer->IsGBufferEnabled() ? "ON" : "OFF") << std::endl;
+				}
+				//Half a stop per press
+				if (e.key.keysym.scancode == SDL_SCANCODE_KP_PLUS || e.key.keysym.scancode == SDL_SCANCODE_KP_MINUS)
+				{
+					const float step = e.key.keysym.scancode == SDL_SCANCODE_KP_PLUS ? 1.41421356f : 1.f / 1.41421356f;
+					pRenderer->SetExposure(pRenderer->GetExposure() * step);
+					std::cout << "Exposure: " << pRenderer->GetExposure() << std::endl;
+				}
 				break;
 			}
 		}
 
 		//--------- Update ---------
-		pScene->Update(pTimer);
+		//Frames are traced on a worker, the camera keeps following input meanwhile and the rest of the scene only changes between frames.
+		//Cancelable frames are also restarted when the camera moved
+		pScene->UpdateCamera(pTimer);
+		if (!pRenderer->IsFrameInFlight() || (cancelableFrames && pRenderer->CancelStaleFrame(pScene)))
+		{
+			pSceneTimer->Update();
+			pScene->UpdateScene(pSceneTimer);
+			pRenderer->BeginFrame(pScene);
+		}
+
+		//--------- Present ---------
+		//The previous frame goes to the window while the next one is being traced
+		pRenderer->UpdateWindow();
 
 		//--------- Render ---------
-		pRenderer->Render(pScene);
+		isFramePresented = pRenderer->PresentFinishedFrame(2);
+
+		//Meshes load in the background, one that failed (already printed) would silently be missing from the picture
+		if (pScene->GetNrFailedLoads() > 0)
+		{
+			result = 1;
+			isLooping = false;
+		}
 
 		//--------- Timer ---------
 		pTimer->Update();
 		printTimer += pTimer->GetElapsed();
+		frameTime += pTimer->GetElapsed();
+		if (isFramePresented)
+		{
+			++nrPresentedFrames;
+			pRenderer->UpdateDynamicResolution(frameTime);
+			frameTime = 0.f;
+		}
 		if (printTimer >= 1.f)
 		{
+			//The loop runs more often than frames get presented
+			std::cout << "dFPS: " << nrPresentedFrames / printTimer;
+			if (pRenderer->IsDynamicResolutionEnabled())
+				std::cout << " (render scale " << pRenderer->GetRenderScale() << ")";
+			std::cout << std::endl;
 			printTimer = 0.f;
-			std::cout << "dFPS: " << pTimer->GetdFPS() << std::endl;
+			nrPresentedFrames = 0;
 		}
 
 		//Save screenshot after full render
-		if (takeScreenshot)
+		if (takeScreenshot && isFramePresented)
 		{
-			if (!pRenderer->SaveBufferToImage())
-				std::cout << "Screenshot saved!" << std::endl;
-			else
-				std::cout << "Something went wrong. Screenshot not saved!" << std::endl;
+			pRenderer->CaptureFrame(*pScreenshotQueue);
 			takeScreenshot = false;
 		}
+
+		if (isRecording && isFramePresented)
+			pRenderer->CaptureFrame(*pRecordingQueue);
+
+		if (pStreamQueue && isFramePresented)
+		{
+			pRenderer->CaptureFrame(*pStreamQueue);
+
+			//Consumer closed the stream
+			if (pStreamQueue->GetNrFailedFrames() > 0)
+				isLooping = false;
+		}
 	}
 	pTimer->Stop();
+	pRenderer->CancelFrame();
 
 	//Shutdown "framework"
+	delete pStreamQueue;
+	delete pVideoStream;
+	delete pRecordingQueue;
+	delete pScreenshotQueue;
 	delete pScene;
 	delete pRenderer;
+	delete pSceneTimer;
 	delete pTimer;
 
 	ShutDown(pWindow);
-	return 0;
+	return result;
 }
\ No newline at end of file